@@ -0,0 +1,28 @@
+# Writes 'OUTPUT', a header with the revision of 'SOURCE_DIR' and 'FLAGS'.
+# Run at every build, the header only rewritten when they change so what
+# includes it only compiles again then
+
+set(MATSU_REVISION "unknown")
+if (GIT_EXECUTABLE)
+	execute_process(COMMAND ${GIT_EXECUTABLE} describe --always --dirty WORKING_DIRECTORY ${SOURCE_DIR}
+	                OUTPUT_VARIABLE MATSU_DESCRIBE OUTPUT_STRIP_TRAILING_WHITESPACE ERROR_QUIET
+	                RESULT_VARIABLE MATSU_DESCRIBE_RESULT)
+	if (MATSU_DESCRIBE_RESULT EQUAL 0 AND MATSU_DESCRIBE)
+		set(MATSU_REVISION "${MATSU_DESCRIBE}")
+	endif ()
+endif ()
+
+string(REPLACE "\\" "\\\\" MATSU_FLAGS "${FLAGS}")
+string(REPLACE "\"" "\\\"" MATSU_FLAGS "${MATSU_FLAGS}")
+
+string(CONCAT MATSU_HEADER "// Generated by 'cmake/revision.cmake'\n"
+                           "#define MATSU_GIT_REVISION \"${MATSU_REVISION}\"\n"
+                           "#define MATSU_BUILD_FLAGS \"${MATSU_FLAGS}\"\n")
+
+set(MATSU_PREVIOUS "")
+if (EXISTS "${OUTPUT}")
+	file(READ "${OUTPUT}" MATSU_PREVIOUS)
+endif ()
+if (NOT MATSU_PREVIOUS STREQUAL MATSU_HEADER)
+	file(WRITE "${OUTPUT}" "${MATSU_HEADER}")
+endif ()
@@ -1,22 +1,80 @@
 #!/bin/bash
+set -e
 
-./606-kick
-./606-snare
-./606-hat-closed
-./606-hat-open
-./606-tom-low
-./606-tom-high
-
-flac -8 -e --no-padding -f 606-kick.wav
-flac -8 -e --no-padding -f 606-snare.wav
-flac -8 -e --no-padding -f 606-hat-closed.wav
-flac -8 -e --no-padding -f 606-hat-open.wav
-flac -8 -e --no-padding -f 606-tom-low.wav
-flac -8 -e --no-padding -f 606-tom-high.wav
-
-cp -f ../resources/matsu-606.sfz matsu-606.sfz
-
-zip -9 -D matsu.zip matsu-606.sfz \
-606-kick.flac 606-snare.flac \
-606-hat-closed.flac 606-hat-open.flac \
-606-tom-low.flac 606-tom-high.flac
+# Incremental, voices whose inputs didn't change since last run aren't
+# rendered or encoded again. Inputs of a voice being its program (parameters
+# and renderer are compiled in) and the encoder; recorded in a manifest
+# along with hashes of outputs, to catch files modified or gone.
+
+MANIFEST="matsu.manifest"
+VOICES="606-kick 606-snare 606-hat-closed 606-hat-open 606-tom-low 606-tom-high"
+FLAC_OPTIONS="-8 -e --no-padding"
+
+Hash()
+{
+	if command -v sha256sum > /dev/null; then
+		sha256sum "$@" | cut -d " " -f 1
+	else
+		shasum -a 256 "$@" | cut -d " " -f 1
+	fi
+}
+
+Recorded()
+{
+	# Manifest lines: name, inputs hash, outputs hash
+	if [ -f "$MANIFEST" ]; then
+		grep "^$1 " "$MANIFEST" | cut -d " " -f "$2"
+	fi
+}
+
+ENCODER=$( (flac --version; echo "$FLAC_OPTIONS") | Hash)
+NEW_MANIFEST=$(mktemp)
+CHANGES=0
+
+for VOICE in $VOICES; do
+	INPUTS=$( (Hash "./$VOICE"; echo "$ENCODER") | Hash)
+	OUTPUTS=""
+
+	if [ -f "$VOICE.wav" ] && [ -f "$VOICE.flac" ]; then
+		OUTPUTS=$(cat "$VOICE.wav" "$VOICE.flac" | Hash)
+	fi
+
+	if [ "$INPUTS" == "$(Recorded "$VOICE" 2)" ] && [ "$OUTPUTS" == "$(Recorded "$VOICE" 3)" ]; then
+		echo "$VOICE: unchanged"
+	else
+		echo "$VOICE: rendering"
+		"./$VOICE"
+		flac $FLAC_OPTIONS -f "$VOICE.wav"
+
+		OUTPUTS=$(cat "$VOICE.wav" "$VOICE.flac" | Hash)
+		CHANGES=1
+	fi
+
+	echo "$VOICE $INPUTS $OUTPUTS" >> "$NEW_MANIFEST"
+done
+
+./606-sfz --sfz-only --extension flac
+
+# Package, only if something went into it changed
+PACKAGE_INPUTS=$(cat "$NEW_MANIFEST" matsu-606.sfz | Hash)
+PACKAGE_OUTPUTS=""
+
+if [ -f matsu.zip ]; then
+	PACKAGE_OUTPUTS=$(Hash matsu.zip)
+fi
+
+if [ $CHANGES == 0 ] && [ "$PACKAGE_INPUTS" == "$(Recorded matsu.zip 2)" ] &&
+   [ "$PACKAGE_OUTPUTS" == "$(Recorded matsu.zip 3)" ]; then
+	echo "matsu.zip: unchanged"
+else
+	rm -f matsu.zip
+	zip -9 -D matsu.zip matsu-606.sfz \
+	606-kick.flac 606-snare.flac \
+	606-hat-closed.flac 606-hat-open.flac \
+	606-tom-low.flac 606-tom-high.flac
+
+	PACKAGE_OUTPUTS=$(Hash matsu.zip)
+fi
+
+echo "matsu.zip $PACKAGE_INPUTS $PACKAGE_OUTPUTS" >> "$NEW_MANIFEST"
+mv -f "$NEW_MANIFEST" "$MANIFEST"
@@ -0,0 +1,257 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_ALLOCATION_TRACKING
+#define MATSU_ALLOCATION_TRACKING
+#endif
+
+#include "606.hpp"
+#include "allocation.hpp"
+#include "batch.hpp"
+#include "dual.hpp"
+#include "perceptual.hpp"
+
+// Usage: 606-allocations [--threads n]
+// Proves that what runs per hit doesn't touch the heap once set up: every
+// voice rendered (at several sampling frequencies, with parameters, with
+// 'Dual' samples), streamed, analysed as exports do, and in parallel
+// batches, each worker counted on its own thread. Plus perceptual analyses
+// once their vectors have grown. First of each done once outside, as
+// setup. Exits with 1 if anything allocated
+
+
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+static constexpr double SAMPLING_FREQUENCIES[] = {44100.0, 96000.0}; // For plain renders
+
+static bool Report(const char* what, bool passed)
+{
+	printf("%-44s %s\n", what, (passed == true) ? "no allocations" : "ALLOCATED");
+	return passed;
+}
+
+
+static bool CheckTracking()
+{
+	// That counting works at all, or every check below passes regardless
+	AllocationScope scope;
+	int* volatile p = new int(1);
+	delete p;
+
+	return scope.Get().allocations == 1;
+}
+
+static bool CheckRenders(const Voice& voice, double sampling_frequency)
+{
+	RenderBuffer buffer(static_cast<size_t>(sampling_frequency) * 4);
+	const std::vector<double> defaults = ParameterDefaults(voice.parameters, voice.parameters_no);
+	char what[128];
+	bool passed = true;
+
+	auto out = Output(buffer.GetData(), buffer.GetLength());
+	voice.render(sampling_frequency, Hit(), &out);
+
+	{
+		snprintf(what, sizeof(what), "%s, %.1f kHz", voice.name, sampling_frequency / 1000.0);
+		AllocationScope scope;
+		out = Output(buffer.GetData(), buffer.GetLength());
+		voice.render(sampling_frequency, Hit(), &out);
+		passed = Report(what, scope.Check(what)) && passed;
+	}
+	{
+		snprintf(what, sizeof(what), "%s, %.1f kHz, parameters", voice.name, sampling_frequency / 1000.0);
+		AllocationScope scope;
+		out = Output(buffer.GetData(), buffer.GetLength());
+		voice.render_parameters(sampling_frequency, Hit(), defaults.data(), &out);
+		passed = Report(what, scope.Check(what)) && passed;
+	}
+
+	return passed;
+}
+
+static bool CheckDualRender(const Voice& voice)
+{
+	using Sample = Dual<4>;
+	std::vector<Sample> buffer(static_cast<size_t>(SAMPLING_FREQUENCY) * 4);
+	std::vector<Sample> values(voice.parameters_no);
+	for (size_t i = 0; i < voice.parameters_no; i += 1)
+		values[i] = (i < 4) ? Sample::Variable(voice.parameters[i].value, i) : Sample(voice.parameters[i].value);
+
+	char what[128];
+	snprintf(what, sizeof(what), "%s, dual samples", voice.name);
+
+	AllocationScope scope;
+	auto out = BasicOutput<Sample>(buffer.data(), buffer.size());
+	if (RenderVoice(voice, SAMPLING_FREQUENCY, Hit(), values.data(), &out) != 0)
+	{
+		fprintf(stderr, "No render with derivatives for '%s'\n", voice.name);
+		return false;
+	}
+
+	return Report(what, scope.Check(what));
+}
+
+static bool CheckStream(const Voice& voice, StreamFormat format, const char* format_name)
+{
+	FILE* fp = tmpfile();
+	if (fp == nullptr)
+		return Report("Stream, temporary file", false);
+
+	auto stream = Stream(fp, format, SAMPLING_FREQUENCY, true);
+	auto out = stream.GetOutput();
+	voice.render(SAMPLING_FREQUENCY, Hit(), &out);
+	out.Flush();
+
+	char what[128];
+	snprintf(what, sizeof(what), "%s, stream %s", voice.name, format_name);
+
+	bool passed;
+	{
+		AllocationScope scope;
+		out = stream.GetOutput();
+		voice.render(SAMPLING_FREQUENCY, Hit(), &out);
+		out.Flush();
+		passed = Report(what, scope.Check(what));
+	}
+
+	fclose(fp);
+	return passed;
+}
+
+static bool CheckExport(const Voice& voice)
+{
+	// What exports step every sample through, peaks and loudness. Their
+	// file and buffer allocated once per export, as are the results
+	RenderBuffer buffer(static_cast<size_t>(SAMPLING_FREQUENCY) * 4);
+	auto out = Output(buffer.GetData(), buffer.GetLength());
+	voice.render(SAMPLING_FREQUENCY, Hit(), &out);
+	const size_t length = out.GetLength();
+
+	char what[128];
+	snprintf(what, sizeof(what), "%s, export", voice.name);
+
+	auto peaks = PeakEnvelope(length);
+	auto meter = LoudnessMeter(SAMPLING_FREQUENCY, length);
+
+	AllocationScope scope;
+	for (size_t i = 0; i < length; i += 1)
+	{
+		peaks.Step(buffer.GetData()[i]);
+		meter.Step(buffer.GetData()[i]);
+	}
+
+	return Report(what, scope.Check(what));
+}
+
+static bool CheckBatch(size_t workers)
+{
+	// Every voice as jobs, each worker with its own buffer and counts
+	const size_t voices = sizeof(VOICES_606) / sizeof(Voice);
+	const size_t jobs = voices * 4;
+
+	std::vector<RenderBuffer> buffers;
+	for (size_t w = 0; w < workers; w += 1)
+		buffers.emplace_back(static_cast<size_t>(SAMPLING_FREQUENCY) * 4);
+
+	std::vector<uint64_t> allocations(jobs, 0);
+	BatchRun(jobs, workers,
+	         [&](size_t job, size_t w)
+	         {
+		         const Voice& voice = VOICES_606[job % voices];
+		         AllocationScope scope;
+
+		         auto out = Output(buffers[w].GetData(), buffers[w].GetLength());
+		         voice.render(SAMPLING_FREQUENCY, Hit(), &out);
+		         allocations[job] = scope.Get().allocations;
+	         });
+
+	bool passed = true;
+	for (size_t job = 0; job < jobs; job += 1)
+	{
+		if (allocations[job] != 0)
+		{
+			fprintf(stderr, "%s, batch job %zu: %llu allocations\n", VOICES_606[job % voices].name, job,
+			        static_cast<unsigned long long>(allocations[job]));
+			passed = false;
+		}
+	}
+
+	char what[128];
+	snprintf(what, sizeof(what), "Batch, %zu renders on %zu threads", jobs, workers);
+	return Report(what, passed);
+}
+
+static bool CheckPerceptual()
+{
+	RenderBuffer a(static_cast<size_t>(SAMPLING_FREQUENCY) * 4);
+	RenderBuffer b(static_cast<size_t>(SAMPLING_FREQUENCY) * 4);
+	auto out_a = Output(a.GetData(), a.GetLength());
+	auto out_b = Output(b.GetData(), b.GetLength());
+	VOICES_606[0].render(SAMPLING_FREQUENCY, Hit(), &out_a);
+	VOICES_606[1].render(SAMPLING_FREQUENCY, Hit(), &out_b);
+
+	auto analysis = PerceptualAnalysis(SAMPLING_FREQUENCY);
+	PerceptualFeatures features_a;
+	PerceptualFeatures features_b;
+	analysis.Analyse(a.GetData(), out_a.GetLength(), &features_a);
+	analysis.Analyse(b.GetData(), out_b.GetLength(), &features_b);
+
+	// Same lengths again, vectors already grown to size
+	const char* what = "Perceptual analysis and distance";
+	AllocationScope scope;
+	analysis.Analyse(a.GetData(), out_a.GetLength(), &features_a);
+	analysis.Analyse(b.GetData(), out_b.GetLength(), &features_b);
+	PerceptualDistance(features_a, features_b);
+
+	return Report(what, scope.Check(what));
+}
+
+
+int main(int argc, const char* argv[])
+{
+	size_t threads = 0;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else
+		{
+			fprintf(stderr, "Usage: 606-allocations [--threads n]\n");
+			return 1;
+		}
+	}
+
+	if (CheckTracking() == false)
+	{
+		fprintf(stderr, "Allocations not tracked, replacement of 'operator new' not in use\n");
+		return 1;
+	}
+
+	bool passed = true;
+	for (const Voice& voice : VOICES_606)
+	{
+		for (const double sampling_frequency : SAMPLING_FREQUENCIES)
+			passed = CheckRenders(voice, sampling_frequency) && passed;
+
+		passed = CheckDualRender(voice) && passed;
+		passed = CheckStream(voice, StreamFormat::S24, "s24") && passed;
+		passed = CheckStream(voice, StreamFormat::F32, "f32") && passed;
+		passed = CheckExport(voice) && passed;
+	}
+
+	passed = CheckBatch(Max(BatchWorkers(threads), static_cast<size_t>(2))) && passed;
+	passed = CheckPerceptual() && passed;
+
+	printf("\n%s\n", (passed == true) ? "No allocations after setup" : "Allocations after setup");
+	return (passed == true) ? 0 : 1;
+}
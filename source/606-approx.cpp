@@ -0,0 +1,200 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "bench.hpp"
+
+// Usage: 606-approx [--repetitions n]
+// Every voice with every combination of approximate kernels, speed against
+// quality. Quality measured against the exact render: SNR, and THD+N being
+// what isn't the reference (error) relative to it. Combinations marked
+// with '*' are Pareto optimal, nothing else both faster and better
+
+
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+static constexpr unsigned COMBINATIONS_NO = 1 << KERNELS_NO;
+
+static const char* KERNEL_NAMES[KERNELS_NO] = {"sin", "exp", "lut"};
+
+using RenderFunction = int (*)(double, const Hit&, Output*);
+
+template <unsigned K> static const RenderFunction* Renders()
+{
+	// Every voice, same order as 'VOICES_606', with kernels 'K'
+	static const RenderFunction renders[] = {RenderKick<K>,    RenderSnare<K>,  RenderHatClosed<K>,
+	                                         RenderHatOpen<K>, RenderTomLow<K>, RenderTomHigh<K>};
+	static_assert(sizeof(renders) / sizeof(RenderFunction) == sizeof(VOICES_606) / sizeof(Voice), "");
+	return renders;
+}
+
+static_assert(COMBINATIONS_NO == 8, "");
+static const RenderFunction* const RENDERS[COMBINATIONS_NO] = {Renders<0>(), Renders<1>(), Renders<2>(), Renders<3>(),
+                                                               Renders<4>(), Renders<5>(), Renders<6>(), Renders<7>()};
+
+struct Measure
+{
+	unsigned kernels;
+	double ns_per_sample;
+	double snr_db;
+	double thd_n; // In percent
+	double max_error;
+	bool pareto;
+};
+
+
+static void CombinationName(unsigned kernels, char* out, size_t size)
+{
+	snprintf(out, size, "exact");
+	size_t len = 0;
+
+	for (unsigned k = 0; k < KERNELS_NO; k += 1)
+	{
+		if ((kernels & (1u << k)) != 0)
+			len += static_cast<size_t>(snprintf(out + len, size - len, "%s%s", (len == 0) ? "" : "+", KERNEL_NAMES[k]));
+	}
+}
+
+
+static void MarkPareto(std::vector<Measure>* measures)
+{
+	for (Measure& m : *measures)
+	{
+		m.pareto = true;
+		for (const Measure& o : *measures)
+		{
+			const bool dominates = (o.ns_per_sample <= m.ns_per_sample && o.snr_db >= m.snr_db) &&
+			                       (o.ns_per_sample < m.ns_per_sample || o.snr_db > m.snr_db);
+			m.pareto = m.pareto && (dominates == false);
+		}
+	}
+}
+
+
+static void PrintTable(const char* title, std::vector<Measure> measures)
+{
+	// Fastest first
+	std::sort(measures.begin(), measures.end(),
+	          [](const Measure& a, const Measure& b) { return a.ns_per_sample < b.ns_per_sample; });
+
+	printf("\n%s\n", title);
+	printf(" %-16s %12s %10s %10s %12s %12s\n", "Kernels", "ns/sample", "Speedup", "SNR dB", "THD+N %", "Max error");
+
+	double exact = 0.0;
+	for (const Measure& m : measures)
+		exact = (m.kernels == 0) ? m.ns_per_sample : exact;
+
+	for (const Measure& m : measures)
+	{
+		char name[64];
+		CombinationName(m.kernels, name, sizeof(name));
+
+		printf("%s%-16s %12.3f %9.2fx %10.1f %12.2e %12.2e\n", (m.pareto == true) ? "*" : " ", name,
+		       m.ns_per_sample, exact / m.ns_per_sample, m.snr_db, m.thd_n, m.max_error);
+	}
+}
+
+
+int main(int argc, const char* argv[])
+{
+	size_t repetitions = 21;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+			repetitions = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+	}
+
+	RenderBuffer reference(static_cast<size_t>(SAMPLING_FREQUENCY) * 2);
+	RenderBuffer render_buffer(static_cast<size_t>(SAMPLING_FREQUENCY) * 2);
+
+	// Across all voices, time summed, quality of the worst one
+	std::vector<Measure> overall(COMBINATIONS_NO);
+	for (unsigned c = 0; c < COMBINATIONS_NO; c += 1)
+		overall[c] = {c, 0.0, INFINITY, 0.0, 0.0, false};
+	size_t overall_length = 0;
+
+	for (size_t v = 0; v < sizeof(VOICES_606) / sizeof(Voice); v += 1)
+	{
+		const Voice& voice = VOICES_606[v];
+
+		auto ref_out = Output(reference.GetData(), reference.GetLength());
+		voice.render(SAMPLING_FREQUENCY, Hit(), &ref_out);
+		overall_length += ref_out.GetLength();
+
+		std::vector<Measure> measures;
+
+		for (unsigned c = 0; c < COMBINATIONS_NO; c += 1)
+		{
+			const RenderFunction render = RENDERS[c][v];
+
+			// Speed
+			std::vector<double> ns_per_sample;
+			size_t length = 0;
+
+			for (size_t r = 0; r < repetitions + 1; r += 1)
+			{
+				auto out = Output(render_buffer.GetData(), render_buffer.GetLength());
+				const auto start = std::chrono::steady_clock::now();
+				render(SAMPLING_FREQUENCY, Hit(), &out);
+				const auto end = std::chrono::steady_clock::now();
+
+				length = out.GetLength();
+				g_bench_sink = render_buffer.GetData()[length - 1];
+
+				if (r != 0) // First one as warmup
+					ns_per_sample.push_back(std::chrono::duration<double, std::nano>(end - start).count() /
+					                        static_cast<double>(length));
+			}
+
+			// Quality
+			const double* ref = reference.GetData();
+			const double* data = render_buffer.GetData();
+			double signal = 0.0;
+			double error = 0.0;
+			double max_error = 0.0;
+
+			for (size_t i = 0; i < Min(length, ref_out.GetLength()); i += 1)
+			{
+				signal += ref[i] * ref[i];
+				error += (data[i] - ref[i]) * (data[i] - ref[i]);
+				max_error = Max(max_error, fabs(data[i] - ref[i]));
+			}
+
+			if (length != ref_out.GetLength())
+				error = INFINITY;
+
+			Measure m;
+			m.kernels = c;
+			m.ns_per_sample = BenchSummary(ns_per_sample).median;
+			m.snr_db = (error > 0.0) ? 10.0 * log10(signal / error) : INFINITY;
+			m.thd_n = sqrt(error / signal) * 100.0;
+			m.max_error = max_error;
+			measures.push_back(m);
+
+			overall[c].ns_per_sample += m.ns_per_sample * static_cast<double>(length);
+			overall[c].snr_db = Min(overall[c].snr_db, m.snr_db);
+			overall[c].thd_n = Max(overall[c].thd_n, m.thd_n);
+			overall[c].max_error = Max(overall[c].max_error, m.max_error);
+		}
+
+		MarkPareto(&measures);
+		PrintTable(voice.name, measures);
+	}
+
+	for (Measure& m : overall)
+		m.ns_per_sample /= static_cast<double>(overall_length);
+
+	MarkPareto(&overall);
+	PrintTable("All voices (time over all, quality of the worst)", overall);
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "bench.hpp"
+
+#include <string>
+
+// Usage: 606-bench [--warmup n] [--repetitions n] [--counters] [--json file] [filter]
+// Every voice, whole, at usual sampling frequencies. Realtime factor
+// being seconds of audio rendered per second
+// With '--counters' also hardware counters per sample, Linux only. With
+// '--json' results, along with host and build, go to a file as well
+
+
+static const double SAMPLING_FREQUENCIES[] = {44100.0, 48000.0, 96000.0, 192000.0};
+
+int main(int argc, const char* argv[])
+{
+	size_t warmup = 5;
+	size_t repetitions = 51;
+	const char* filter = nullptr;
+	bool counters = false;
+	const char* json = nullptr;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmup = static_cast<size_t>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+			repetitions = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--counters") == 0)
+			counters = true;
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			json = argv[++i];
+		else
+			filter = argv[i];
+	}
+
+	RenderBuffer render_buffer(static_cast<size_t>(SAMPLING_FREQUENCIES[3]) * 2);
+	std::vector<std::string> names; // Bench keeps pointers to them
+	names.reserve(sizeof(VOICES_606) / sizeof(Voice) * sizeof(SAMPLING_FREQUENCIES) / sizeof(double));
+
+	auto bench = Bench(warmup, repetitions, filter, counters);
+	bench.PrintHeader();
+
+	for (const Voice& voice : VOICES_606)
+	{
+		for (const double sampling_frequency : SAMPLING_FREQUENCIES)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "%s, %g kHz", voice.name, sampling_frequency / 1000.0);
+			names.push_back(name);
+
+			// Length first, a voice knows it only while rendering
+			auto out = Output(render_buffer.GetData(), render_buffer.GetLength());
+			voice.render(sampling_frequency, Hit(), &out);
+
+			bench.Run(
+			    names.back().c_str(), out.GetLength(),
+			    [&](size_t)
+			    {
+				    auto o = Output(render_buffer.GetData(), render_buffer.GetLength());
+				    voice.render(sampling_frequency, Hit(), &o);
+				    return render_buffer.GetData()[o.GetLength() - 1];
+			    },
+			    sampling_frequency);
+		}
+	}
+
+	if (json != nullptr && bench.WriteJson(json) == false)
+	{
+		fprintf(stderr, "Error writing '%s'\n", json);
+		return 1;
+	}
+
+	return 0;
+}
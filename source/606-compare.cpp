@@ -0,0 +1,216 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "perceptual.hpp"
+
+#include <chrono>
+
+// Usage: 606-compare render reference.wav [--frame n] [--hop n] [--over-time]
+// Energy per octave band over time of a render against a reference, as
+// differences in dB (render minus reference). 'render' being a Wav file or
+// a voice name ('606-kick'), rendered then at the reference sampling
+// frequency. Both taken from their first sample, no alignment. Band and
+// frame pairs quieter than 80 dB under the loudest reference one don't
+// count, there differences are meaningless. Last, a perceptual distance
+// (mel bands, Mfcc and onset envelope) between both
+
+
+static constexpr double FLOOR_DB = 80.0;
+
+int main(int argc, const char* argv[])
+{
+	const char* filenames[2] = {nullptr, nullptr};
+	size_t frame_length = 2048;
+	size_t hop = 512;
+	bool over_time = false;
+	int files = 0;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--frame") == 0 && i + 1 < argc)
+			frame_length = static_cast<size_t>(Max(atoi(argv[++i]), 64));
+		else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc)
+			hop = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--over-time") == 0)
+			over_time = true;
+		else if (files < 2)
+			filenames[files++] = argv[i];
+	}
+
+	if (files != 2)
+	{
+		fprintf(stderr, "Usage: 606-compare render reference.wav [--frame n] [--hop n] [--over-time]\n");
+		return 1;
+	}
+
+	// Reference, then render
+	RenderBuffer reference;
+	RenderBuffer render;
+	size_t render_length = 0;
+	double sampling_frequency = 0.0;
+	double render_sampling_frequency = 0.0;
+
+	if (ImportWav(filenames[1], &reference, &sampling_frequency) == false)
+	{
+		fprintf(stderr, "Error reading '%s'\n", filenames[1]);
+		return 1;
+	}
+
+	const Voice* voice = nullptr;
+	for (const Voice& v : VOICES_606)
+		voice = (strcmp(v.name, filenames[0]) == 0) ? &v : voice;
+
+	if (voice != nullptr)
+	{
+		render_sampling_frequency = sampling_frequency;
+		render.Resize(static_cast<size_t>(sampling_frequency) * 2);
+
+		auto out = Output(render.GetData(), render.GetLength());
+		voice->render(sampling_frequency, Hit(), &out);
+		render_length = out.GetLength();
+	}
+	else if (ImportWav(filenames[0], &render, &render_sampling_frequency) == true)
+	{
+		render_length = render.GetLength();
+	}
+	else
+	{
+		fprintf(stderr, "Error reading '%s'\n", filenames[0]);
+		return 1;
+	}
+
+	if (render_sampling_frequency != sampling_frequency)
+	{
+		fprintf(stderr, "Sampling frequencies differ, %g Hz and %g Hz\n", render_sampling_frequency,
+		        sampling_frequency);
+		return 1;
+	}
+
+	// Analyse, the longest decides the number of frames
+	const auto start = std::chrono::steady_clock::now();
+
+	auto stft = Stft(frame_length, hop, Window::Hann);
+	const auto bands = OctaveBands(31.25, Min(16000.0, sampling_frequency / 2.0 / sqrt(2.0)));
+	const size_t length = Max(render_length, reference.GetLength());
+	const size_t frames = stft.GetFrames(length);
+
+	std::vector<double> power;
+	std::vector<double> energy[2];
+	const double* signals[2] = {render.GetData(), reference.GetData()};
+	const size_t lengths[2] = {render_length, reference.GetLength()};
+
+	for (size_t s = 0; s < 2; s += 1)
+	{
+		// Padded to the same length
+		RenderBuffer padded(length);
+		memcpy(padded.GetData(), signals[s], sizeof(double) * lengths[s]);
+
+		stft.Power(padded.GetData(), length, &power);
+		BandEnergies(power.data(), frames, stft.GetBins(), sampling_frequency, bands, &energy[s]);
+	}
+
+	const double elapsed =
+	    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// Report
+	double loudest = -200.0;
+	for (const double e : energy[1])
+		loudest = Max(loudest, e);
+
+	std::vector<double> sum(bands.size(), 0.0);
+	std::vector<double> max_abs(bands.size(), 0.0);
+	std::vector<size_t> counted(bands.size(), 0);
+	double total = 0.0;
+	size_t total_counted = 0;
+
+	if (over_time == true)
+	{
+		printf("%9s", "ms");
+		for (const Band& b : bands)
+			printf(" %7.0f", sqrt(b.low * b.high));
+		printf("\n");
+	}
+
+	for (size_t f = 0; f < frames; f += 1)
+	{
+		if (over_time == true)
+			printf("%9.1f", static_cast<double>(f * stft.GetHop()) / sampling_frequency * 1000.0);
+
+		for (size_t b = 0; b < bands.size(); b += 1)
+		{
+			const double r = energy[0][f * bands.size() + b];
+			const double ref = energy[1][f * bands.size() + b];
+
+			if (Max(r, ref) < loudest - FLOOR_DB)
+			{
+				if (over_time == true)
+					printf(" %7s", "-");
+				continue;
+			}
+
+			sum[b] += r - ref;
+			max_abs[b] = Max(max_abs[b], fabs(r - ref));
+			counted[b] += 1;
+			total += fabs(r - ref);
+			total_counted += 1;
+
+			if (over_time == true)
+				printf(" %+7.1f", r - ref);
+		}
+
+		if (over_time == true)
+			printf("\n");
+	}
+
+	printf("%s against %s, %g Hz, %zu frames of %zu every %zu\n\n", filenames[0], filenames[1],
+	       sampling_frequency, frames, stft.GetFrameLength(), stft.GetHop());
+	printf("%9s %12s %12s\n", "Band Hz", "Mean dB", "Max abs dB");
+
+	for (size_t b = 0; b < bands.size(); b += 1)
+	{
+		if (counted[b] == 0)
+		{
+			printf("%9.0f %12s %12s\n", sqrt(bands[b].low * bands[b].high), "-", "-");
+			continue;
+		}
+
+		printf("%9.0f %+12.2f %12.2f\n", sqrt(bands[b].low * bands[b].high),
+		       sum[b] / static_cast<double>(counted[b]), max_abs[b]);
+	}
+
+	printf("\nMean abs difference %.3f dB, analysis took %.2f ms\n",
+	       (total_counted != 0) ? total / static_cast<double>(total_counted) : 0.0, elapsed);
+
+	// Perceptual
+	{
+		const auto perceptual_start = std::chrono::steady_clock::now();
+
+		auto analysis = PerceptualAnalysis(sampling_frequency);
+		PerceptualFeatures features[2];
+		for (size_t s = 0; s < 2; s += 1)
+			analysis.Analyse(signals[s], lengths[s], &features[s]);
+
+		double components[PERCEPTUAL_COMPONENTS_NO];
+		const double distance = PerceptualDistance(features[0], features[1], PerceptualWeights(), components);
+
+		const double perceptual_elapsed =
+		    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - perceptual_start).count();
+
+		printf("Perceptual distance %.3f (mel %.2f dB, Mfcc %.2f dB, onset %.2f dB), took %.2f ms\n", distance,
+		       components[PERCEPTUAL_MEL], components[PERCEPTUAL_MFCC], components[PERCEPTUAL_ONSET],
+		       perceptual_elapsed);
+	}
+
+	return 0;
+}
@@ -0,0 +1,678 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "batch.hpp"
+#include "dual.hpp"
+#include "perceptual.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+// Usage: 606-fit voice reference.wav [--generations n] [--population n] [--threads n]
+//                [--parameters name,name...] [--seed n] [--perceptual] [--gradient]
+// Fits parameters of a voice to a reference recording, minimizing the
+// distance between their third octave band energies over time, or with
+// '--perceptual' a mel, Mfcc and onset envelope one. Search by
+// Cma-Es with a diagonal covariance (sep-Cma-Es), whole generations
+// rendered in parallel. Parameters normalized to their ranges, starting
+// from defaults. Prints the best set, and writes its render as
+// 'voice-fit.wav'. Without '--parameters' all of them fitted
+// With '--gradient' instead Levenberg-Marquardt, from renders carrying
+// derivatives ('Dual' samples), for up to 16 parameters. Generations
+// being then its iterations. Far fewer renders, but local: it goes to the
+// closest minimum from defaults
+
+// https://arxiv.org/abs/1604.00772 (Hansen, the tutorial)
+// https://hal.inria.fr/inria-00287367 (Ros, Hansen, separable variant)
+
+
+static constexpr double FLOOR_DB = 80.0; // Under the loudest reference band, all the same
+
+class Distance
+{
+	// To a reference, one per worker as analyses have state
+  public:
+	Distance(const double* reference, size_t length, double sampling_frequency, bool perceptual)
+	    : m_stft(1024, 256, Window::Hann), m_analysis(sampling_frequency)
+	{
+		m_perceptual = perceptual;
+		m_sampling_frequency = sampling_frequency;
+		m_length = length;
+		m_bands = OctaveBands(31.25, Min(16000.0, sampling_frequency / 2.0 / sqrt(2.0)), 3);
+
+		Energies(reference, length, &m_reference);
+		m_analysis.Analyse(reference, length, &m_reference_features);
+
+		m_floor = -200.0;
+		for (const double e : m_reference)
+			m_floor = Max(m_floor, e - FLOOR_DB);
+	}
+
+	double operator()(const double* render, size_t length)
+	{
+		if (m_perceptual == true)
+		{
+			m_analysis.Analyse(render, length, &m_features);
+			return PerceptualDistance(m_features, m_reference_features);
+		}
+
+		// Mean squared difference in dB, the render cut or padded to the
+		// reference length
+		m_padded.assign(m_length, 0.0);
+		memcpy(m_padded.data(), render, sizeof(double) * Min(length, m_length));
+		Energies(m_padded.data(), m_length, &m_energies);
+
+		double sum = 0.0;
+		for (size_t i = 0; i < m_energies.size(); i += 1)
+		{
+			const double d = Max(m_energies[i], m_floor) - Max(m_reference[i], m_floor);
+			sum += d * d;
+		}
+
+		return sum / static_cast<double>(m_energies.size());
+	}
+
+  private:
+	Stft m_stft;
+	PerceptualAnalysis m_analysis;
+	std::vector<Band> m_bands;
+	bool m_perceptual;
+	double m_sampling_frequency;
+	size_t m_length;
+	double m_floor;
+
+	std::vector<double> m_reference;
+	std::vector<double> m_energies;
+	std::vector<double> m_padded;
+	std::vector<double> m_power;
+
+	PerceptualFeatures m_reference_features;
+	PerceptualFeatures m_features;
+
+	void Energies(const double* in, size_t length, std::vector<double>* out)
+	{
+		const size_t frames = m_stft.Power(in, length, &m_power);
+		BandEnergies(m_power.data(), frames, m_stft.GetBins(), m_sampling_frequency, m_bands, out);
+	}
+};
+
+
+static double Gaussian(uint64_t* state)
+{
+	// Box-Muller, one of the pair thrown away
+	const double u1 = (static_cast<double>(Random(state) >> 11) + 1.0) * 1.11022302462515654042363166809e-16;
+	const double u2 = static_cast<double>(Random(state) >> 11) * 1.11022302462515654042363166809e-16;
+	return sqrt(-2.0 * log(u1)) * cos(M_PI_TWO * u2);
+}
+
+
+static constexpr size_t GRADIENT_PARAMETERS_MAX = 16;
+using GradientSample = Dual<GRADIENT_PARAMETERS_MAX>;
+
+class Residuals
+{
+	// Same distance as above (not perceptual), as residuals of every frame
+	// and band along with derivatives of them. Band energies being sums of
+	// squared magnitudes, those come from spectra of the derivatives of the
+	// render, as transforms are linear
+  public:
+	Residuals(const double* reference, size_t length, double sampling_frequency) : m_stft(1024, 256, Window::Hann)
+	{
+		m_length = length;
+		m_bands = OctaveBands(31.25, Min(16000.0, sampling_frequency / 2.0 / sqrt(2.0)), 3);
+
+		std::vector<double> power;
+		const size_t frames = m_stft.Power(reference, length, &power);
+		BandEnergies(power.data(), frames, m_stft.GetBins(), sampling_frequency, m_bands, &m_reference);
+
+		m_floor = -200.0;
+		for (const double e : m_reference)
+			m_floor = Max(m_floor, e - FLOOR_DB);
+
+		// Bins of every band, as 'BandEnergies()' takes them
+		const double bin_width = sampling_frequency / static_cast<double>((m_stft.GetBins() - 1) * 2);
+		for (const Band& band : m_bands)
+		{
+			m_first.push_back(static_cast<size_t>(ceil(band.low / bin_width)));
+			m_last.push_back(Min(static_cast<size_t>(ceil(band.high / bin_width)), m_stft.GetBins()));
+		}
+	}
+
+	double operator()(const GradientSample* render, size_t length, size_t n, std::vector<double>* jtj,
+	                  std::vector<double>* jtr)
+	{
+		// Returns the distance, mean of squared residuals 'r', and gives
+		// 'J^T * J' and 'J^T * r' ('J' being derivatives of residuals) for
+		// the first 'n' derivatives
+		const size_t bins = m_stft.GetBins();
+		const size_t bands = m_bands.size();
+
+		// Value and derivatives apart, cut or padded to the reference length
+		m_signals.assign((n + 1) * m_length, 0.0);
+		for (size_t i = 0; i < Min(length, m_length); i += 1)
+		{
+			m_signals[i] = render[i].value;
+			for (size_t j = 0; j < n; j += 1)
+				m_signals[(j + 1) * m_length + i] = render[i].d[j];
+		}
+
+		m_re.resize((n + 1) * bins);
+		m_im.resize((n + 1) * bins);
+		m_gradient.resize(n);
+		jtj->assign(n * n, 0.0);
+		jtr->assign(n, 0.0);
+
+		const size_t frames = m_stft.GetFrames(m_length);
+		double sum = 0.0;
+
+		for (size_t f = 0; f < frames; f += 1)
+		{
+			for (size_t j = 0; j < n + 1; j += 1)
+				m_stft.Spectrum(&m_signals[j * m_length], m_length, f, &m_re[j * bins], &m_im[j * bins]);
+
+			for (size_t b = 0; b < bands; b += 1)
+			{
+				double power = 0.0;
+				for (size_t k = m_first[b]; k < m_last[b]; k += 1)
+					power += m_re[k] * m_re[k] + m_im[k] * m_im[k];
+
+				const double energy = 10.0 * log10(Max(power, 1e-20));
+				const double r = Max(energy, m_floor) - Max(m_reference[f * bands + b], m_floor);
+				sum += r * r;
+
+				// Flat under the floor
+				if (energy <= m_floor || power <= 1e-20)
+					continue;
+
+				for (size_t j = 0; j < n; j += 1)
+				{
+					const double* re = &m_re[(j + 1) * bins];
+					const double* im = &m_im[(j + 1) * bins];
+
+					double d_power = 0.0;
+					for (size_t k = m_first[b]; k < m_last[b]; k += 1)
+						d_power += 2.0 * (m_re[k] * re[k] + m_im[k] * im[k]);
+
+					m_gradient[j] = (10.0 / log(10.0)) * d_power / power;
+				}
+
+				for (size_t j = 0; j < n; j += 1)
+				{
+					(*jtr)[j] += m_gradient[j] * r;
+					for (size_t k = 0; k < n; k += 1)
+						(*jtj)[j * n + k] += m_gradient[j] * m_gradient[k];
+				}
+			}
+		}
+
+		return sum / static_cast<double>(frames * bands);
+	}
+
+  private:
+	Stft m_stft;
+	std::vector<Band> m_bands;
+	std::vector<size_t> m_first;
+	std::vector<size_t> m_last;
+	size_t m_length;
+	double m_floor;
+
+	std::vector<double> m_reference;
+	std::vector<double> m_signals;
+	std::vector<double> m_re;
+	std::vector<double> m_im;
+	std::vector<double> m_gradient;
+};
+
+
+struct Problem
+{
+	const Voice* voice;
+	std::vector<size_t> fitted; // Indices into voice parameters
+	const RenderBuffer* reference;
+	double sampling_frequency;
+	bool perceptual;
+
+	void Denormalize(const double* x, std::vector<double>* values) const
+	{
+		*values = ParameterDefaults(voice->parameters, voice->parameters_no);
+		for (size_t d = 0; d < fitted.size(); d += 1)
+		{
+			const Parameter& p = voice->parameters[fitted[d]];
+			(*values)[fitted[d]] = p.min + Clamp(x[d], 0.0, 1.0) * (p.max - p.min);
+		}
+	}
+};
+
+
+static double SearchCmaEs(const Problem& problem, size_t generations, size_t population, size_t workers,
+                          uint64_t* seed, std::vector<double>* best_x)
+{
+	// Strategy parameters, as in the tutorial with learning rates of the
+	// separable variant
+	const size_t n = problem.fitted.size();
+	const double nd = static_cast<double>(n);
+	const auto lambda_default = static_cast<size_t>(4.0 + floor(3.0 * log(nd)));
+	const size_t lambda = (population != 0) ? population : Max(lambda_default, workers);
+	const size_t mu = lambda / 2;
+
+	std::vector<double> weights(mu);
+	double weights_sum = 0.0;
+	double weights_sq = 0.0;
+	for (size_t i = 0; i < mu; i += 1)
+	{
+		weights[i] = log(static_cast<double>(mu) + 0.5) - log(static_cast<double>(i) + 1.0);
+		weights_sum += weights[i];
+	}
+	for (double& w : weights)
+	{
+		w /= weights_sum;
+		weights_sq += w * w;
+	}
+
+	const double mu_eff = 1.0 / weights_sq;
+	const double c_sigma = (mu_eff + 2.0) / (nd + mu_eff + 5.0);
+	const double d_sigma = 1.0 + 2.0 * Max(0.0, sqrt((mu_eff - 1.0) / (nd + 1.0)) - 1.0) + c_sigma;
+	const double c_c = (4.0 + mu_eff / nd) / (nd + 4.0 + 2.0 * mu_eff / nd);
+	const double c_1 = Min(1.0, 2.0 / ((nd + 1.3) * (nd + 1.3) + mu_eff) * (nd + 2.0) / 3.0);
+	const double c_mu = Min(1.0 - c_1, 2.0 * (mu_eff - 2.0 + 1.0 / mu_eff) / ((nd + 2.0) * (nd + 2.0) + mu_eff) *
+	                                       (nd + 2.0) / 3.0);
+	const double chi_n = sqrt(nd) * (1.0 - 1.0 / (4.0 * nd) + 1.0 / (21.0 * nd * nd));
+
+	// State, in normalized space
+	std::vector<double> mean(*best_x);
+	std::vector<double> c(n, 1.0); // Diagonal covariance
+	std::vector<double> p_sigma(n, 0.0);
+	std::vector<double> p_c(n, 0.0);
+	double sigma = 0.2;
+
+	// Workers
+	std::vector<Distance> distances;
+	std::vector<RenderBuffer> buffers;
+	std::vector<std::vector<double>> values(workers);
+
+	for (size_t w = 0; w < workers; w += 1)
+	{
+		distances.emplace_back(problem.reference->GetData(), problem.reference->GetLength(),
+		                       problem.sampling_frequency, problem.perceptual);
+		buffers.emplace_back(static_cast<size_t>(problem.sampling_frequency) * 4);
+	}
+
+	// Search
+	std::vector<double> y(lambda * n);
+	std::vector<double> x(lambda * n);
+	std::vector<double> fitness(lambda);
+	std::vector<size_t> order(lambda);
+
+	double best = INFINITY;
+	{
+		// Defaults, where we start
+		problem.Denormalize(mean.data(), &values[0]);
+		auto out = Output(buffers[0].GetData(), buffers[0].GetLength());
+		problem.voice->render_parameters(problem.sampling_frequency, Hit(), values[0].data(), &out);
+		best = distances[0](buffers[0].GetData(), out.GetLength());
+		printf("Fitting %zu parameters of '%s', population %zu, %zu threads\n", n, problem.voice->name, lambda,
+		       workers);
+		printf("Defaults distance %.4f\n", best);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	size_t renders = 0;
+
+	for (size_t g = 0; g < generations; g += 1)
+	{
+		// Sample, clamped into ranges; steps kept as taken
+		for (size_t k = 0; k < lambda; k += 1)
+		{
+			for (size_t d = 0; d < n; d += 1)
+			{
+				const double xd = Clamp(mean[d] + sigma * sqrt(c[d]) * Gaussian(seed), 0.0, 1.0);
+				x[k * n + d] = xd;
+				y[k * n + d] = (xd - mean[d]) / sigma;
+			}
+		}
+
+		BatchRun(lambda, workers,
+		         [&](size_t k, size_t w)
+		         {
+			         problem.Denormalize(&x[k * n], &values[w]);
+			         auto out = Output(buffers[w].GetData(), buffers[w].GetLength());
+			         problem.voice->render_parameters(problem.sampling_frequency, Hit(), values[w].data(), &out);
+
+			         const double f = distances[w](buffers[w].GetData(), out.GetLength());
+			         fitness[k] = (isfinite(f) == true) ? f : INFINITY;
+		         });
+		renders += lambda;
+
+		for (size_t k = 0; k < lambda; k += 1)
+			order[k] = k;
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fitness[a] < fitness[b]; });
+
+		if (fitness[order[0]] < best)
+		{
+			best = fitness[order[0]];
+			best_x->assign(&x[order[0] * n], &x[order[0] * n] + n);
+		}
+
+		// Update
+		std::vector<double> y_w(n, 0.0);
+		for (size_t i = 0; i < mu; i += 1)
+			for (size_t d = 0; d < n; d += 1)
+				y_w[d] += weights[i] * y[order[i] * n + d];
+
+		double p_sigma_norm = 0.0;
+		for (size_t d = 0; d < n; d += 1)
+		{
+			mean[d] = Clamp(mean[d] + sigma * y_w[d], 0.0, 1.0);
+			p_sigma[d] = (1.0 - c_sigma) * p_sigma[d] + sqrt(c_sigma * (2.0 - c_sigma) * mu_eff) * y_w[d] / sqrt(c[d]);
+			p_sigma_norm += p_sigma[d] * p_sigma[d];
+		}
+		p_sigma_norm = sqrt(p_sigma_norm);
+
+		const double generation = static_cast<double>(g + 1);
+		const bool h_sigma = p_sigma_norm / sqrt(1.0 - pow(1.0 - c_sigma, 2.0 * generation)) <
+		                     (1.4 + 2.0 / (nd + 1.0)) * chi_n;
+
+		for (size_t d = 0; d < n; d += 1)
+		{
+			p_c[d] = (1.0 - c_c) * p_c[d] + ((h_sigma == true) ? sqrt(c_c * (2.0 - c_c) * mu_eff) : 0.0) * y_w[d];
+
+			double rank_mu = 0.0;
+			for (size_t i = 0; i < mu; i += 1)
+				rank_mu += weights[i] * y[order[i] * n + d] * y[order[i] * n + d];
+
+			c[d] = (1.0 - c_1 - c_mu) * c[d] + c_1 * p_c[d] * p_c[d] + c_mu * rank_mu;
+			c[d] = Max(c[d], 1e-20);
+		}
+
+		sigma *= exp((c_sigma / d_sigma) * (p_sigma_norm / chi_n - 1.0));
+		sigma = Min(sigma, 1.0);
+
+		if ((g + 1) % 10 == 0 || g + 1 == generations)
+		{
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("Generation %4zu, best %.4f, sigma %.4f, %zu renders, %.0f renders/s\n", g + 1, best, sigma,
+			       renders, static_cast<double>(renders) / elapsed);
+		}
+
+		if (sigma < 1e-8)
+			break;
+	}
+
+	return best;
+}
+
+
+static bool Solve(std::vector<double> a, std::vector<double> b, size_t n, std::vector<double>* x)
+{
+	// 'a * x = b', Gaussian elimination with partial pivoting
+	for (size_t col = 0; col < n; col += 1)
+	{
+		size_t pivot = col;
+		for (size_t row = col + 1; row < n; row += 1)
+			pivot = (fabs(a[row * n + col]) > fabs(a[pivot * n + col])) ? row : pivot;
+
+		if (fabs(a[pivot * n + col]) < 1e-300)
+			return false;
+
+		for (size_t k = 0; k < n; k += 1)
+			std::swap(a[col * n + k], a[pivot * n + k]);
+		std::swap(b[col], b[pivot]);
+
+		for (size_t row = col + 1; row < n; row += 1)
+		{
+			const double factor = a[row * n + col] / a[col * n + col];
+			for (size_t k = col; k < n; k += 1)
+				a[row * n + k] -= factor * a[col * n + k];
+			b[row] -= factor * b[col];
+		}
+	}
+
+	x->resize(n);
+	for (size_t row = n; row > 0; row -= 1)
+	{
+		double sum = b[row - 1];
+		for (size_t k = row; k < n; k += 1)
+			sum -= a[(row - 1) * n + k] * (*x)[k];
+		(*x)[row - 1] = sum / a[(row - 1) * n + row - 1];
+	}
+
+	return true;
+}
+
+static double SearchGradient(const Problem& problem, size_t iterations, std::vector<double>* best_x)
+{
+	// Levenberg-Marquardt, steps kept into ranges. Trial steps rendered
+	// plain, only accepted ones again with derivatives. NaN if those fail
+	const size_t n = problem.fitted.size();
+	const size_t buffer_length = static_cast<size_t>(problem.sampling_frequency) * 4;
+
+	auto residuals = Residuals(problem.reference->GetData(), problem.reference->GetLength(),
+	                           problem.sampling_frequency);
+	auto distance = Distance(problem.reference->GetData(), problem.reference->GetLength(),
+	                         problem.sampling_frequency, false);
+
+	std::vector<GradientSample> gradient_buffer(buffer_length);
+	RenderBuffer buffer(buffer_length);
+	std::vector<GradientSample> gradient_values(problem.voice->parameters_no);
+	std::vector<double> values;
+
+	std::vector<double> jtj;
+	std::vector<double> jtr;
+	std::vector<double> a(n * n);
+	std::vector<double> step;
+	std::vector<double> trial(n);
+
+	size_t renders = 0;
+	size_t gradient_renders = 0;
+	bool no_render = false;
+
+	const auto evaluate_gradient = [&]() -> double
+	{
+		// Derivatives with respect to normalized parameters
+		problem.Denormalize(best_x->data(), &values);
+		for (size_t i = 0; i < values.size(); i += 1)
+			gradient_values[i] = values[i];
+		for (size_t d = 0; d < n; d += 1)
+		{
+			const Parameter& p = problem.voice->parameters[problem.fitted[d]];
+			gradient_values[problem.fitted[d]] = GradientSample::Variable(values[problem.fitted[d]], d, p.max - p.min);
+		}
+
+		auto out = BasicOutput<GradientSample>(gradient_buffer.data(), gradient_buffer.size());
+		if (RenderVoice(*problem.voice, problem.sampling_frequency, Hit(), gradient_values.data(), &out) != 0)
+		{
+			fprintf(stderr, "No render with derivatives for '%s'\n", problem.voice->name);
+			no_render = true;
+			return NAN;
+		}
+		gradient_renders += 1;
+
+		return residuals(gradient_buffer.data(), out.GetLength(), n, &jtj, &jtr);
+	};
+
+	double best = evaluate_gradient();
+	double damping = 1e-3;
+	if (no_render == true)
+		return NAN;
+
+	printf("Fitting %zu parameters of '%s', by gradient\n", n, problem.voice->name);
+	printf("Defaults distance %.4f\n", best);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < iterations && damping < 1e10; i += 1)
+	{
+		// Solve '(J^T * J + damping * diag(J^T * J)) * step = -J^T * r'
+		for (size_t j = 0; j < n * n; j += 1)
+			a[j] = jtj[j];
+		for (size_t j = 0; j < n; j += 1)
+			a[j * n + j] += damping * jtj[j * n + j] + 1e-12;
+
+		std::vector<double> minus_jtr(n);
+		for (size_t j = 0; j < n; j += 1)
+			minus_jtr[j] = -jtr[j];
+
+		if (Solve(a, minus_jtr, n, &step) == false)
+			break;
+
+		for (size_t d = 0; d < n; d += 1)
+			trial[d] = Clamp((*best_x)[d] + step[d], 0.0, 1.0);
+
+		problem.Denormalize(trial.data(), &values);
+		auto out = Output(buffer.GetData(), buffer.GetLength());
+		problem.voice->render_parameters(problem.sampling_frequency, Hit(), values.data(), &out);
+		renders += 1;
+
+		const double d = distance(buffer.GetData(), out.GetLength());
+		if (isfinite(d) == true && d < best)
+		{
+			*best_x = trial;
+			best = evaluate_gradient();
+			if (no_render == true)
+				return NAN;
+			damping = Max(damping / 3.0, 1e-9);
+		}
+		else
+		{
+			damping *= 4.0;
+		}
+
+		if ((i + 1) % 10 == 0 || i + 1 == iterations || damping >= 1e10)
+		{
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("Iteration %4zu, best %.4f, damping %.2g, %zu renders + %zu with derivatives, %.1f s\n", i + 1,
+			       best, damping, renders, gradient_renders, elapsed);
+		}
+	}
+
+	return best;
+}
+
+
+int main(int argc, const char* argv[])
+{
+	const char* voice_name = nullptr;
+	const char* reference_filename = nullptr;
+	const char* selection = nullptr;
+	size_t generations = 300;
+	size_t population = 0;
+	size_t threads = 0;
+	uint64_t seed = 1;
+	bool perceptual = false;
+	bool gradient = false;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--generations") == 0 && i + 1 < argc)
+			generations = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--population") == 0 && i + 1 < argc)
+			population = static_cast<size_t>(Max(atoi(argv[++i]), 4));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--parameters") == 0 && i + 1 < argc)
+			selection = argv[++i];
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = Max(static_cast<uint64_t>(strtoull(argv[++i], nullptr, 10)), static_cast<uint64_t>(1));
+		else if (strcmp(argv[i], "--perceptual") == 0)
+			perceptual = true;
+		else if (strcmp(argv[i], "--gradient") == 0)
+			gradient = true;
+		else if (voice_name == nullptr)
+			voice_name = argv[i];
+		else
+			reference_filename = argv[i];
+	}
+
+	Problem problem;
+	problem.voice = nullptr;
+	for (const Voice& v : VOICES_606)
+		problem.voice = (voice_name != nullptr && strcmp(v.name, voice_name) == 0) ? &v : problem.voice;
+
+	if (problem.voice == nullptr || reference_filename == nullptr || (gradient == true && perceptual == true))
+	{
+		fprintf(stderr, "Usage: 606-fit voice reference.wav [--generations n] [--population n] [--threads n]\n"
+		                "                [--parameters name,name...] [--seed n] [--perceptual] [--gradient]\n");
+		return 1;
+	}
+
+	// Reference
+	RenderBuffer reference;
+	if (ImportWav(reference_filename, &reference, &problem.sampling_frequency) == false)
+	{
+		fprintf(stderr, "Error reading '%s'\n", reference_filename);
+		return 1;
+	}
+
+	problem.reference = &reference;
+	problem.perceptual = perceptual;
+
+	// Parameters fitted
+	const Voice* voice = problem.voice;
+	for (size_t i = 0; i < voice->parameters_no; i += 1)
+	{
+		const std::string list = (selection != nullptr) ? "," + std::string(selection) + "," : "";
+		if (selection == nullptr || list.find("," + std::string(voice->parameters[i].name) + ",") != std::string::npos)
+			problem.fitted.push_back(i);
+	}
+
+	if (problem.fitted.size() == 0)
+	{
+		fprintf(stderr, "No such parameters in '%s'\n", voice->name);
+		return 1;
+	}
+
+	if (gradient == true && problem.fitted.size() > GRADIENT_PARAMETERS_MAX)
+	{
+		fprintf(stderr, "At most %zu parameters with '--gradient', '%s' has %zu (choose with '--parameters')\n",
+		        GRADIENT_PARAMETERS_MAX, voice->name, problem.fitted.size());
+		return 1;
+	}
+
+	// Search, from defaults
+	std::vector<double> best_x(problem.fitted.size());
+	for (size_t d = 0; d < problem.fitted.size(); d += 1)
+	{
+		const Parameter& p = voice->parameters[problem.fitted[d]];
+		best_x[d] = (p.value - p.min) / (p.max - p.min);
+	}
+
+	const double best = (gradient == true)
+	                        ? SearchGradient(problem, generations, &best_x)
+	                        : SearchCmaEs(problem, generations, population, BatchWorkers(threads), &seed, &best_x);
+	if (gradient == true && isnan(best) == true)
+		return 1;
+
+	// Result
+	std::vector<double> result;
+	problem.Denormalize(best_x.data(), &result);
+
+	printf("\n%-20s %12s %12s\n", "Parameter", "Default", "Fitted");
+	for (size_t i = 0; i < voice->parameters_no; i += 1)
+	{
+		printf("%-20s %12.6g %12.6g%s\n", voice->parameters[i].name, voice->parameters[i].value, result[i],
+		       (result[i] != voice->parameters[i].value) ? " *" : "");
+	}
+
+	RenderBuffer buffer(static_cast<size_t>(problem.sampling_frequency) * 4);
+	auto out = Output(buffer.GetData(), buffer.GetLength());
+	voice->render_parameters(problem.sampling_frequency, Hit(), result.data(), &out);
+
+	char filename[256];
+	snprintf(filename, sizeof(filename), "%s-fit.wav", voice->name);
+	ExportS24(buffer.GetData(), problem.sampling_frequency, out.GetLength(), filename);
+
+	printf("\nDistance %.4f, render in '%s'\n", best, filename);
+	return 0;
+}
@@ -0,0 +1,336 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "batch.hpp"
+
+#include <chrono>
+
+// Usage: 606-fuzz [case] [--sets n] [--threads n] [--seed n] [--trace file.json]
+// Renders random parameter sets, flagging outputs not finite, exploding,
+// still growing as they end (filters after their input stopped, voices as
+// envelopes close), or not ending before the buffer does. Every voice over
+// the whole of its parameter ranges, random velocities, and at sampling
+// frequencies from 22050 to 96000 Hz. And primitives at the edges of what
+// they take: Q near zero, cutoffs past Nyquist, feedback near one, zero
+// asymmetry. A quarter of values drawn from those edges, rest uniform.
+// Prints the first sets flagged of each case, exits with 1 if any was.
+// Without case all of them. With '--trace' a timeline of batch jobs
+
+
+static constexpr double SAMPLING_FREQUENCIES[] = {22050.0, 32000.0, 44100.0, 48000.0, 96000.0};
+static constexpr double PRIMITIVE_PEAK_MAX = 1000.0; // 60 dB, resonant filters go well over full scale
+static constexpr double VOICE_PEAK_MAX = 16.0;       // 24 dB
+static constexpr size_t REPORTED_MAX = 5;            // Sets printed per case
+
+struct Result
+{
+	const char* problem; // Null if none
+	char set[192];       // What was rendered, to reproduce it
+};
+
+struct Worker
+{
+	Worker() : buffer(static_cast<size_t>(96000.0 * 4.0)) {}
+
+	RenderBuffer buffer;
+	std::vector<double> values;
+};
+
+
+static double Uniform(uint64_t* state, double min, double max)
+{
+	// As 'NoiseGenerator', in [0, 1) here
+	const uint64_t x = Random(state) >> static_cast<uint64_t>(11);
+	return min + (max - min) * (static_cast<double>(x) * 1.11022302462515654042363166809e-16);
+}
+
+static double Draw(uint64_t* state, double min, double max, std::initializer_list<double> edges)
+{
+	if (edges.size() != 0 && Random(state) % 4 == 0)
+		return *(edges.begin() + Random(state) % edges.size());
+
+	return Uniform(state, min, max);
+}
+
+enum class Ending
+{
+	Any,
+	Decaying, // Last quarter not louder than the one before, filters
+	Enveloped // Than the half before, voices. Low tones give a quarter few periods to peak
+};
+
+static const char* Check(const double* x, size_t length, double peak_max, Ending ending)
+{
+	if (length == 0)
+		return "empty";
+
+	double peak = 0.0;
+	for (size_t i = 0; i < length; i += 1)
+	{
+		if (std::isfinite(x[i]) == false)
+			return "not finite";
+		peak = Max(peak, fabs(x[i]));
+	}
+
+	if (peak > peak_max)
+		return "exploding";
+
+	if (ending != Ending::Any)
+	{
+		double before = 0.0;
+		double last = 0.0;
+		for (size_t i = (ending == Ending::Decaying) ? length / 2 : length / 4; i < length * 3 / 4; i += 1)
+			before = Max(before, fabs(x[i]));
+		for (size_t i = length * 3 / 4; i < length; i += 1)
+			last = Max(last, fabs(x[i]));
+
+		if (last > before * 1.001 + 1e-9)
+			return "growing";
+	}
+
+	return nullptr;
+}
+
+
+// Primitives, one second each. Filters take noise for half of it, then silence
+
+static void FuzzTwoPoles(uint64_t* state, Worker* w, Result* r, bool highpass)
+{
+	const double fs = SAMPLING_FREQUENCIES[Random(state) % 5];
+	const double cutoff = Draw(state, 1.0, fs, {0.0, fs / 2.0 - 1.0, fs / 2.0, fs, fs * 2.0});
+	const double q = Draw(state, 0.01, 40.0, {0.0, 1e-9, 1e-3, 100.0});
+	snprintf(r->set, sizeof(r->set), "fs %.0f, cutoff %.9g, q %.9g", fs, cutoff, q);
+
+	auto lp = TwoPolesFilter<FilterType::Lowpass>(cutoff, q, fs);
+	auto hp = TwoPolesFilter<FilterType::Highpass>(cutoff, q, fs);
+	auto noise = NoiseGenerator(Random(state));
+
+	const auto length = static_cast<size_t>(fs);
+	double* x = w->buffer.GetData();
+	for (size_t i = 0; i < length; i += 1)
+	{
+		const double in = (i < length / 2) ? noise.Step() : 0.0;
+		x[i] = (highpass == true) ? hp.Step(in) : lp.Step(in);
+	}
+
+	r->problem = Check(x, length, PRIMITIVE_PEAK_MAX, Ending::Decaying);
+}
+
+static void FuzzOnePole(uint64_t* state, Worker* w, Result* r)
+{
+	const double fs = SAMPLING_FREQUENCIES[Random(state) % 5];
+	const double cutoff = Draw(state, 0.0, fs, {0.0, fs / 2.0, fs, fs * 2.0});
+	snprintf(r->set, sizeof(r->set), "fs %.0f, cutoff %.9g", fs, cutoff);
+
+	auto lp = OnePoleFilter<FilterType::Lowpass>(cutoff, fs);
+	auto hp = OnePoleFilter<FilterType::Highpass>(cutoff, fs);
+	auto noise = NoiseGenerator(Random(state));
+
+	const auto length = static_cast<size_t>(fs);
+	double* x = w->buffer.GetData();
+	for (size_t i = 0; i < length; i += 1)
+	{
+		const double in = (i < length / 2) ? noise.Step() : 0.0;
+		x[i] = lp.Step(in) + hp.Step(in);
+	}
+
+	r->problem = Check(x, length, PRIMITIVE_PEAK_MAX, Ending::Decaying);
+}
+
+static void FuzzOscillator(uint64_t* state, Worker* w, Result* r)
+{
+	const double fs = SAMPLING_FREQUENCIES[Random(state) % 5];
+	const double frequency_a = Draw(state, 0.0, fs, {0.0, fs / 2.0, fs});
+	const double frequency_b = Draw(state, 0.0, fs, {0.0, fs / 2.0, fs});
+	const double feedback_a = Draw(state, 0.0, 1.0, {1.0, 1.0 - 1e-9, 0.999});
+	const double feedback_b = Draw(state, 0.0, 1.0, {1.0, 1.0 - 1e-9, 0.999});
+	const double duration = Draw(state, 0.0, 2000.0, {0.0, 1e-6});
+	const double easing = Draw(state, 1.0, 20.0, {1.0, 20.0});
+	snprintf(r->set, sizeof(r->set), "fs %.0f, frequencies %.9g %.9g, feedbacks %.9g %.9g, duration %.9g, easing %.9g",
+	         fs, frequency_a, frequency_b, feedback_a, feedback_b, duration, easing);
+
+	auto osc = Oscillator(frequency_a, frequency_b, feedback_a, feedback_b, duration, fs);
+	const auto curve = EasingCurve(easing);
+
+	const auto length = static_cast<size_t>(fs);
+	double* x = w->buffer.GetData();
+	for (size_t i = 0; i < length; i += 1)
+		x[i] = osc.Step([&](double s) { return curve(1.0 - s); });
+
+	r->problem = Check(x, length, PRIMITIVE_PEAK_MAX, Ending::Any);
+}
+
+static void FuzzDistortion(uint64_t* state, Worker* w, Result* r)
+{
+	// Over its input range, exact zero and ends included
+	const double d = Draw(state, 0.5, 12.0, {0.5, 12.0}) * ((Random(state) % 2 == 0) ? 1.0 : -1.0);
+	const double asymmetry = Draw(state, 0.01, 1.0, {0.0, 1e-12, 1e-3, 1.0});
+	snprintf(r->set, sizeof(r->set), "d %.9g, asymmetry %.9g", d, asymmetry);
+
+	const auto curve = DistortionCurve(d, asymmetry);
+	const size_t length = 4097;
+
+	double* x = w->buffer.GetData();
+	for (size_t i = 0; i < length; i += 1)
+	{
+		const double in = static_cast<double>(i) / static_cast<double>(length - 1) * 2.0 - 1.0;
+		x[i] = (i % 2 == 0) ? curve(in) : Distortion(in, d, asymmetry);
+	}
+
+	r->problem = Check(x, length, PRIMITIVE_PEAK_MAX, Ending::Any);
+}
+
+
+static void FuzzVoice(const Voice& voice, uint64_t* state, Worker* w, Result* r)
+{
+	const double fs = SAMPLING_FREQUENCIES[Random(state) % 5];
+
+	Hit hit;
+	hit.velocity = Draw(state, 0.0, 1.0, {0.0, 1.0});
+	hit.seed = Random(state) | 1;
+
+	int written = snprintf(r->set, sizeof(r->set), "fs %.0f, velocity %.3g, set", fs, hit.velocity);
+	w->values.resize(voice.parameters_no);
+	for (size_t i = 0; i < voice.parameters_no; i += 1)
+	{
+		const Parameter& p = voice.parameters[i];
+		w->values[i] = Draw(state, p.min, p.max, {p.min, p.max});
+
+		if (written > 0 && static_cast<size_t>(written) < sizeof(r->set))
+			written += snprintf(r->set + written, sizeof(r->set) - static_cast<size_t>(written), " %.4g", w->values[i]);
+	}
+
+	auto out = Output(w->buffer.GetData(), w->buffer.GetLength());
+	voice.render_parameters(fs, hit, w->values.data(), &out);
+
+	// A full buffer is a render cut, 'Put()' drops what doesn't fit
+	if (out.GetLength() == w->buffer.GetLength())
+		r->problem = "not ending";
+	else
+		r->problem = Check(w->buffer.GetData(), out.GetLength(), VOICE_PEAK_MAX, Ending::Enveloped);
+}
+
+
+struct Case
+{
+	const char* name;
+	const Voice* voice; // Or a primitive
+	void (*fuzz)(uint64_t* state, Worker* w, Result* r);
+};
+
+// clang-format off
+static const Case PRIMITIVES[] = {
+	{"two-poles-lowpass",  nullptr, [](uint64_t* s, Worker* w, Result* r) { FuzzTwoPoles(s, w, r, false); }},
+	{"two-poles-highpass", nullptr, [](uint64_t* s, Worker* w, Result* r) { FuzzTwoPoles(s, w, r, true); }},
+	{"one-pole",           nullptr, FuzzOnePole},
+	{"oscillator",         nullptr, FuzzOscillator},
+	{"distortion",         nullptr, FuzzDistortion},
+};
+// clang-format on
+
+
+static bool Fuzz(const Case& c, size_t sets, size_t workers, uint64_t seed)
+{
+	std::vector<Worker> state(workers);
+	std::vector<Result> results(sets);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	BatchRun(sets, workers,
+	         [&](size_t s, size_t w)
+	         {
+		         // A state per set, sets reproducible whatever thread takes them
+		         uint64_t set_state = (seed * 0x9E3779B97F4A7C15) ^ (static_cast<uint64_t>(s) + 1);
+		         Random(&set_state);
+
+		         if (c.voice != nullptr)
+			         FuzzVoice(*c.voice, &set_state, &state[w], &results[s]);
+		         else
+			         c.fuzz(&set_state, &state[w], &results[s]);
+	         });
+
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t flagged = 0;
+	for (const Result& r : results)
+	{
+		if (r.problem == nullptr)
+			continue;
+
+		if (flagged < REPORTED_MAX)
+			printf("    %s: %s\n", r.problem, r.set);
+		flagged += 1;
+	}
+
+	printf("%-20s %6zu sets, %6zu flagged, %.2f s\n", c.name, sets, flagged, elapsed);
+	return (flagged == 0);
+}
+
+
+int main(int argc, const char* argv[])
+{
+	const char* name = nullptr;
+	size_t sets = 1000;
+	size_t threads = 0;
+	uint64_t seed = 1;
+	const char* trace_filename = nullptr;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--sets") == 0 && i + 1 < argc)
+			sets = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = Max(static_cast<uint64_t>(strtoull(argv[++i], nullptr, 10)), static_cast<uint64_t>(1));
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			trace_filename = argv[++i];
+		else
+			name = argv[i];
+	}
+
+	std::vector<Case> cases(std::begin(PRIMITIVES), std::end(PRIMITIVES));
+	for (const Voice& voice : VOICES_606)
+		cases.push_back({voice.name, &voice, nullptr});
+
+	if (trace_filename != nullptr)
+		TraceStart();
+
+	bool found = false;
+	bool passed = true;
+	const size_t workers = BatchWorkers(threads);
+
+	for (const Case& c : cases)
+	{
+		if (name != nullptr && strcmp(c.name, name) != 0)
+			continue;
+
+		passed = Fuzz(c, sets, workers, seed) && passed;
+		found = true;
+	}
+
+	if (found == false)
+	{
+		fprintf(stderr, "Usage: 606-fuzz [case] [--sets n] [--threads n] [--seed n] [--trace file.json]\n");
+		return 1;
+	}
+
+	if (trace_filename != nullptr && TraceWrite(trace_filename) == false)
+	{
+		fprintf(stderr, "Error writing '%s'\n", trace_filename);
+		return 1;
+	}
+
+	return (passed == true) ? 0 : 1;
+}
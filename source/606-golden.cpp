@@ -0,0 +1,287 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "dual.hpp"
+#include "spectral.hpp"
+
+// Usage: 606-golden [--update] [directory]
+// Renders every voice and compares against reference renders (f64 WAVs in
+// 'directory', 'golden' by default, the ones checked in at the root of the
+// repository), exits with 1 if any goes beyond its tolerances. With
+// '--update' writes references instead, to be done only from a build whose
+// output is known to be right. Also renders every voice with 'Dual'
+// samples, values having to be those of the plain render (or derivatives
+// '606-fit' follows aren't of what it measures)
+
+
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+static constexpr double DUAL_MAX_ABS = 1e-12; // Same operations, some in another order
+
+struct Case
+{
+	const char* suffix;
+	Hit hit;
+};
+
+struct Tolerance
+{
+	const char* voice;
+	double max_abs;     // Largest difference of any sample
+	double rms;         // Of differences
+	double spectral_db; // Mean log spectral distance
+};
+
+// clang-format off
+static const Case CASES[] = {
+	{"",        {1.0, 1}},
+	{"-v50-s2", {0.5, 2}},
+};
+
+// Hats are noise through clipping and distortion, small changes
+// upstream end amplified
+static const Tolerance TOLERANCES[] = {
+	{"606-kick",       1e-6, 1e-7, 0.05},
+	{"606-snare",      1e-6, 1e-7, 0.05},
+	{"606-hat-closed", 1e-5, 1e-6, 0.25},
+	{"606-hat-open",   1e-5, 1e-6, 0.25},
+	{"606-tom-low",    1e-6, 1e-7, 0.05},
+	{"606-tom-high",   1e-6, 1e-7, 0.05},
+};
+// clang-format on
+
+
+static const Tolerance* FindTolerance(const char* voice)
+{
+	// By name, tables free to be in any order
+	for (const Tolerance& t : TOLERANCES)
+	{
+		if (strcmp(t.voice, voice) == 0)
+			return &t;
+	}
+
+	return nullptr;
+}
+
+
+static double DualDifference(const Voice& voice, RenderBuffer* buffer)
+{
+	// Largest difference of values against the plain render, defaults with
+	// derivatives of the first parameters. Infinite if lengths differ
+	using Sample = Dual<4>;
+	const std::vector<double> defaults = ParameterDefaults(voice.parameters, voice.parameters_no);
+	std::vector<Sample> values(voice.parameters_no);
+	for (size_t i = 0; i < voice.parameters_no; i += 1)
+		values[i] = (i < 4) ? Sample::Variable(defaults[i], i) : Sample(defaults[i]);
+
+	auto out = Output(buffer->GetData(), buffer->GetLength());
+	voice.render_parameters(SAMPLING_FREQUENCY, Hit(), defaults.data(), &out);
+
+	std::vector<Sample> dual_buffer(buffer->GetLength());
+	auto dual_out = BasicOutput<Sample>(dual_buffer.data(), dual_buffer.size());
+	if (RenderVoice(voice, SAMPLING_FREQUENCY, Hit(), values.data(), &dual_out) != 0 ||
+	    dual_out.GetLength() != out.GetLength())
+		return INFINITY;
+
+	double max_abs = 0.0;
+	for (size_t i = 0; i < out.GetLength(); i += 1)
+		max_abs = Max(max_abs, fabs(dual_buffer[i].value - buffer->GetData()[i]));
+
+	return (isnan(max_abs) == true) ? INFINITY : max_abs;
+}
+
+
+static double SpectralDistance(const double* a, const double* b, size_t length)
+{
+	// Hann windowed frames, per frame rms of differences in dB over bins
+	// not below -120 dB in both, averaged over frames
+	auto stft = Stft(2048, 1024, Window::Hann);
+	std::vector<double> pa;
+	std::vector<double> pb;
+	const size_t frames = stft.Power(a, length, &pa);
+	stft.Power(b, length, &pb);
+
+	const size_t bins = stft.GetBins();
+	double sum = 0.0;
+	size_t counted = 0;
+
+	for (size_t f = 0; f < frames; f += 1)
+	{
+		double frame_sum = 0.0;
+		size_t n = 0;
+		for (size_t i = f * bins; i < (f + 1) * bins; i += 1)
+		{
+			const double db_a = 10.0 * log10(Max(pa[i], 1e-12));
+			const double db_b = 10.0 * log10(Max(pb[i], 1e-12));
+			if (db_a > -120.0 || db_b > -120.0)
+			{
+				frame_sum += (db_a - db_b) * (db_a - db_b);
+				n += 1;
+			}
+		}
+
+		if (n != 0)
+		{
+			sum += sqrt(frame_sum / static_cast<double>(n));
+			counted += 1;
+		}
+	}
+
+	return (counted != 0) ? sum / static_cast<double>(counted) : 0.0;
+}
+
+
+static uint64_t UlpDistance(double a, double b)
+{
+	// Doubles as integers ordered the same way, negatives mirrored
+	int64_t ia;
+	int64_t ib;
+	memcpy(&ia, &a, sizeof(double));
+	memcpy(&ib, &b, sizeof(double));
+
+	ia = (ia < 0) ? INT64_MIN - ia : ia;
+	ib = (ib < 0) ? INT64_MIN - ib : ib;
+	return (ia > ib) ? static_cast<uint64_t>(ia) - static_cast<uint64_t>(ib)
+	                 : static_cast<uint64_t>(ib) - static_cast<uint64_t>(ia);
+}
+
+
+int main(int argc, const char* argv[])
+{
+	bool update = false;
+	const char* directory = "golden";
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--update") == 0)
+			update = true;
+		else
+			directory = argv[i];
+	}
+
+	RenderBuffer render_buffer(static_cast<size_t>(SAMPLING_FREQUENCY) * 2);
+	RenderBuffer reference;
+	int failures = 0;
+
+	if (update == false)
+		printf(" %-24s %12s %12s %12s %10s\n", "Voice", "Max abs", "RMS", "Max ULP", "Spec. dB");
+
+	for (size_t v = 0; v < sizeof(VOICES_606) / sizeof(Voice); v += 1)
+	{
+		const Voice& voice = VOICES_606[v];
+		const Tolerance* tolerance = FindTolerance(voice.name);
+		if (tolerance == nullptr)
+		{
+			fprintf(stderr, "No tolerances for '%s'\n", voice.name);
+			return 1;
+		}
+
+		for (const Case& c : CASES)
+		{
+			char name[64];
+			char filename[512];
+			snprintf(name, sizeof(name), "%s%s", voice.name, c.suffix);
+			snprintf(filename, sizeof(filename), "%s/%s.wav", directory, name);
+
+			auto out = Output(render_buffer.GetData(), render_buffer.GetLength());
+			voice.render(SAMPLING_FREQUENCY, c.hit, &out);
+			const double* data = render_buffer.GetData();
+			const size_t length = out.GetLength();
+
+			if (update == true)
+			{
+				drwav_data_format format;
+				format.container = drwav_container_riff;
+				format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+				format.channels = 1;
+				format.sampleRate = static_cast<drwav_uint32>(SAMPLING_FREQUENCY);
+				format.bitsPerSample = 64;
+
+				// Read back, to not leave a reference that isn't exactly this render.
+				// Compared as values, the mixdown of 'ImportWav()' turning -0 into 0
+				double reference_fs = 0.0;
+				EncodeWav(&format, data, length, nullptr, filename);
+				bool exact = ImportWav(filename, &reference, &reference_fs);
+				exact = (exact == true && reference.GetLength() == length);
+				for (size_t i = 0; i < length && exact == true; i += 1)
+					exact = (reference.GetData()[i] == data[i]);
+
+				if (exact == false)
+				{
+					fprintf(stderr, "Error writing '%s'\n", filename);
+					return 1;
+				}
+
+				printf("%s\n", filename);
+				continue;
+			}
+
+			double reference_fs = 0.0;
+			if (ImportWav(filename, &reference, &reference_fs) == false)
+			{
+				printf(" %-24s missing '%s'\n", name, filename);
+				failures += 1;
+				continue;
+			}
+
+			if (reference.GetLength() != length || reference_fs != SAMPLING_FREQUENCY)
+			{
+				printf(" %-24s length %zu, reference %zu\n", name, length, reference.GetLength());
+				failures += 1;
+				continue;
+			}
+
+			// Compare
+			const double* ref = reference.GetData();
+			double max_abs = 0.0;
+			double sum = 0.0;
+			uint64_t max_ulp = 0;
+
+			for (size_t i = 0; i < length; i += 1)
+			{
+				const double d = fabs(data[i] - ref[i]);
+				max_abs = Max(max_abs, d);
+				sum += d * d;
+				max_ulp = (UlpDistance(data[i], ref[i]) > max_ulp) ? UlpDistance(data[i], ref[i]) : max_ulp;
+			}
+
+			const double rms = sqrt(sum / static_cast<double>(Max(length, static_cast<size_t>(1))));
+			const double spectral = SpectralDistance(data, ref, length);
+
+			// NaNs fail too, comparisons written so
+			const bool pass = (max_abs <= tolerance->max_abs && rms <= tolerance->rms &&
+			                   spectral <= tolerance->spectral_db);
+			printf(" %-24s %12.3e %12.3e %12llu %10.4f%s\n", name, max_abs, rms,
+			       static_cast<unsigned long long>(max_ulp), spectral, (pass == true) ? "" : " FAIL");
+
+			failures += (pass == true) ? 0 : 1;
+		}
+
+		if (update == false)
+		{
+			const double max_abs = DualDifference(voice, &render_buffer);
+			const bool pass = (max_abs <= DUAL_MAX_ABS);
+
+			char name[64];
+			snprintf(name, sizeof(name), "%s-dual", voice.name);
+			printf(" %-24s %12.3e%s\n", name, max_abs, (pass == true) ? "" : " FAIL");
+
+			failures += (pass == true) ? 0 : 1;
+		}
+	}
+
+	if (update == false)
+		printf("%s\n", (failures == 0) ? "All within tolerances" : "Failures!");
+
+	return (failures == 0) ? 0 : 1;
+}
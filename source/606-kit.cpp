@@ -0,0 +1,49 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "kit.hpp"
+
+
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+static constexpr size_t VOICES_NO = sizeof(VOICES_606) / sizeof(Voice);
+
+int main(int argc, const char* argv[])
+{
+	// Float samples by default, '--s16' halves the size
+	const KitFormat format = (argc > 1 && strcmp(argv[1], "--s16") == 0) ? KitFormat::S16 : KitFormat::F32;
+
+	std::vector<double> render_buffers[VOICES_NO];
+	KitVoice voices[VOICES_NO];
+
+	for (size_t i = 0; i < VOICES_NO; i += 1)
+	{
+		render_buffers[i].resize(static_cast<size_t>(SAMPLING_FREQUENCY) * 2);
+
+		auto out = Output(render_buffers[i].data(), render_buffers[i].size());
+		VOICES_606[i].render(SAMPLING_FREQUENCY, Hit(), &out);
+
+		voices[i].name = VOICES_606[i].name;
+		voices[i].samples = render_buffers[i].data();
+		voices[i].length = out.GetLength();
+		voices[i].sampling_frequency = SAMPLING_FREQUENCY;
+	}
+
+	if (ExportKit(voices, VOICES_NO, format, "matsu-606.kit") != 0)
+	{
+		fprintf(stderr, "Error writing 'matsu-606.kit'\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "lossless.hpp"
+
+#include <chrono>
+
+// Renders every voice into '.mtl' files, checking on the way that they
+// decode back to the exact s24 render, and how fast
+
+
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+
+int main()
+{
+	static double render_buffer[static_cast<size_t>(SAMPLING_FREQUENCY) * 2];
+	int failures = 0;
+
+	printf("%-16s %10s %10s %8s %12s\n", "Voice", "Wav s24", "Mtl", "Ratio", "Decode");
+
+	for (const Voice& voice : VOICES_606)
+	{
+		auto out = Output(render_buffer, sizeof(render_buffer) / sizeof(double));
+		voice.render(SAMPLING_FREQUENCY, Hit(), &out);
+
+		std::vector<int32_t> samples(out.GetLength());
+		for (size_t i = 0; i < out.GetLength(); i += 1)
+			samples[i] = ToS24(render_buffer[i]);
+
+		const std::vector<uint8_t> encoded = LosslessEncode(samples.data(), samples.size(), SAMPLING_FREQUENCY);
+
+		// Round trip
+		std::vector<int32_t> decoded;
+		double sampling_frequency = 0.0;
+
+		if (LosslessDecode(encoded.data(), encoded.size(), &decoded, &sampling_frequency) == false ||
+		    decoded != samples || sampling_frequency != SAMPLING_FREQUENCY)
+		{
+			fprintf(stderr, "%s: round trip mismatch\n", voice.name);
+			failures += 1;
+			continue;
+		}
+
+		// Decode speed, of output as int32
+		size_t repetitions = 0;
+		const auto start = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration<double>(0.0);
+
+		for (; elapsed.count() < 0.25; repetitions += 1)
+		{
+			LosslessDecode(encoded.data(), encoded.size(), &decoded, &sampling_frequency);
+			elapsed = std::chrono::steady_clock::now() - start;
+		}
+
+		const double gbs = static_cast<double>(repetitions * samples.size() * sizeof(int32_t)) / elapsed.count() / 1e9;
+		const size_t wav_size = samples.size() * 3;
+
+		printf("%-16s %10zu %10zu %7.1f%% %7.2f GB/s\n", voice.name, wav_size, encoded.size(),
+		       static_cast<double>(encoded.size()) / static_cast<double>(wav_size) * 100.0, gbs);
+
+		// Save it
+		char filename[256];
+		snprintf(filename, sizeof(filename), "%s.mtl", voice.name);
+
+		FILE* fp = fopen(filename, "wb");
+		if (fp == nullptr || fwrite(encoded.data(), 1, encoded.size(), fp) != encoded.size())
+		{
+			fprintf(stderr, "Error writing '%s'\n", filename);
+			failures += 1;
+		}
+
+		if (fp != nullptr)
+			fclose(fp);
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_PROFILE
+#define MATSU_PROFILE
+#endif
+
+#include "606.hpp"
+
+// Usage: 606-profile [--repetitions n] [sampling frequency]
+// Where, inside every voice, time goes. Ticks per call with the cost of
+// an empty scope taken out, 'Other' being whatever no stage covers
+
+
+int main(int argc, const char* argv[])
+{
+	int repetitions = 20;
+	double sampling_frequency = 48000.0;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+			repetitions = Max(atoi(argv[++i]), 1);
+		else
+			sampling_frequency = Max(atof(argv[i]), 8000.0);
+	}
+
+	RenderBuffer render_buffer(static_cast<size_t>(sampling_frequency) * 2);
+	const double overhead = ProfileOverhead();
+
+	printf("Sampling frequency %g Hz, %i repetitions, %.1f ticks of overhead per scope\n", sampling_frequency,
+	       repetitions, overhead);
+
+	for (const Voice& voice : VOICES_606)
+	{
+		// First render registers stages, not counted
+		auto out = Output(render_buffer.GetData(), render_buffer.GetLength());
+		voice.render(sampling_frequency, Hit(), &out);
+		ProfileReset();
+
+		const uint64_t start = ProfileTicks();
+		for (int r = 0; r < repetitions; r += 1)
+		{
+			out = Output(render_buffer.GetData(), render_buffer.GetLength());
+			voice.render(sampling_frequency, Hit(), &out);
+		}
+
+		// Scopes themselves aren't part of the voice
+		const ProfileStages& s = GetProfileStages();
+		double total = static_cast<double>(ProfileTicks() - start);
+		for (size_t i = 0; i < s.no; i += 1)
+			total -= overhead * static_cast<double>(s.stages[i].calls);
+		total = Max(total, 1.0);
+
+		printf("\n%s, %zu samples, %.1f ticks per sample\n", voice.name, out.GetLength(),
+		       total / static_cast<double>(out.GetLength() * static_cast<size_t>(repetitions)));
+		printf(" %-20s %12s %14s %8s\n", "Stage", "Calls", "Ticks/call", "%");
+
+		// Same name in different scopes is one stage
+		double attributed = 0.0;
+
+		for (size_t i = 0; i < s.no; i += 1)
+		{
+			bool seen = false;
+			for (size_t p = 0; p < i; p += 1)
+				seen = seen || (s.stages[p].calls != 0 && strcmp(s.stages[p].name, s.stages[i].name) == 0);
+
+			if (s.stages[i].calls == 0 || seen == true)
+				continue;
+
+			uint64_t calls = 0;
+			double ticks = 0.0;
+			for (size_t o = i; o < s.no; o += 1)
+			{
+				if (s.stages[o].calls != 0 && strcmp(s.stages[o].name, s.stages[i].name) == 0)
+				{
+					calls += s.stages[o].calls;
+					ticks += Max(static_cast<double>(s.stages[o].ticks) -
+					                 overhead * static_cast<double>(s.stages[o].calls),
+					             0.0);
+				}
+			}
+
+			attributed += ticks;
+			printf(" %-20s %12llu %14.2f %7.2f%%\n", s.stages[i].name, static_cast<unsigned long long>(calls),
+			       ticks / static_cast<double>(calls), ticks / total * 100.0);
+		}
+
+		const double other = Max(total - attributed, 0.0);
+		printf(" %-20s %12s %14s %7.2f%%\n", "Other", "-", "-", other / total * 100.0);
+	}
+
+	return 0;
+}
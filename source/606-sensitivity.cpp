@@ -0,0 +1,293 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "batch.hpp"
+#include "spectral.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+// Usage: 606-sensitivity [voice] [--trajectories n] [--threads n] [--seed n]
+// How much each parameter of a voice matters, by Morris screening: random
+// trajectories over a grid of the (normalized) parameter ranges, moving
+// one parameter at a time. Mean of absolute elementary effects (mu*) per
+// feature, that is, change of it when a parameter goes over its whole range.
+// Plus their deviation (sigma) for the spectrum, a large one hinting at
+// non linear effects or interactions with other parameters. Without voice
+// all of them
+
+// https://doi.org/10.1080/00401706.1991.10484804 (Morris)
+// https://doi.org/10.1016/j.envsoft.2006.10.004 (Campolongo et al., mu*)
+
+
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+static constexpr int LEVELS = 4;
+static constexpr double DELTA = LEVELS / (2.0 * (LEVELS - 1.0));
+static constexpr double DECAY_DB = 40.0; // Decay time until this under the peak
+static constexpr double FLOOR_DB = 80.0; // Bands under the loudest one ignored
+
+enum Feature
+{
+	FEATURE_SPECTRUM, // Mean abs difference of octave bands over time, dB
+	FEATURE_ENERGY,   // dB
+	FEATURE_PEAK,     // dB
+	FEATURE_DECAY,    // Ms
+	FEATURE_CENTROID, // Octaves
+	FEATURES_NO
+};
+
+static const char* FEATURE_NAMES[FEATURES_NO] = {"Spectrum dB", "Energy dB", "Peak dB", "Decay ms", "Centroid oct"};
+
+struct Point
+{
+	// Scalar features, 'FEATURE_SPECTRUM' being a distance between points
+	double features[FEATURES_NO];
+	std::vector<double> energies; // Frame after frame of bands
+	size_t frames;
+};
+
+struct Worker
+{
+	Worker() : stft(2048, 512, Window::Hann), buffer(static_cast<size_t>(SAMPLING_FREQUENCY) * 4) {}
+
+	Stft stft;
+	RenderBuffer buffer;
+	std::vector<double> values;
+	std::vector<double> power;
+};
+
+
+static void Analyse(const double* x, size_t length, const std::vector<Band>& bands, Worker* w, Point* point)
+{
+	double energy = 0.0;
+	double peak = 0.0;
+	for (size_t i = 0; i < length; i += 1)
+	{
+		energy += x[i] * x[i];
+		peak = Max(peak, fabs(x[i]));
+	}
+
+	size_t decay = 0;
+	const double threshold = peak * pow(10.0, -DECAY_DB / 20.0);
+	for (size_t i = 0; i < length; i += 1)
+		decay = (fabs(x[i]) > threshold) ? i : decay;
+
+	// Spectrum
+	point->frames = w->stft.Power(x, length, &w->power);
+	BandEnergies(w->power.data(), point->frames, w->stft.GetBins(), SAMPLING_FREQUENCY, bands, &point->energies);
+
+	const size_t bins = w->stft.GetBins();
+	const double bin_width = SAMPLING_FREQUENCY / static_cast<double>((bins - 1) * 2);
+	double weighted = 0.0;
+	double total = 0.0;
+	for (size_t f = 0; f < point->frames; f += 1)
+	{
+		for (size_t i = 1; i < bins; i += 1)
+		{
+			weighted += w->power[f * bins + i] * static_cast<double>(i) * bin_width;
+			total += w->power[f * bins + i];
+		}
+	}
+
+	point->features[FEATURE_SPECTRUM] = 0.0;
+	point->features[FEATURE_ENERGY] = 10.0 * log10(Max(energy / SAMPLING_FREQUENCY, 1e-20));
+	point->features[FEATURE_PEAK] = 20.0 * log10(Max(peak, 1e-10));
+	point->features[FEATURE_DECAY] = static_cast<double>(decay) / SAMPLING_FREQUENCY * 1000.0;
+	point->features[FEATURE_CENTROID] = log2(Max(weighted / Max(total, 1e-20), 1.0));
+}
+
+static double SpectrumDistance(const Point& a, const Point& b, size_t bands)
+{
+	// Mean abs difference, the shortest padded with silence. Ignoring pairs
+	// under the floor of the loudest band of both
+	double loudest = -200.0;
+	for (const double e : a.energies)
+		loudest = Max(loudest, e);
+	for (const double e : b.energies)
+		loudest = Max(loudest, e);
+
+	const double floor = loudest - FLOOR_DB;
+	double sum = 0.0;
+	size_t counted = 0;
+
+	for (size_t f = 0; f < Max(a.frames, b.frames); f += 1)
+	{
+		for (size_t i = 0; i < bands; i += 1)
+		{
+			const double ea = (f < a.frames) ? Max(a.energies[f * bands + i], floor) : floor;
+			const double eb = (f < b.frames) ? Max(b.energies[f * bands + i], floor) : floor;
+
+			if (ea > floor || eb > floor)
+			{
+				sum += fabs(ea - eb);
+				counted += 1;
+			}
+		}
+	}
+
+	return (counted != 0) ? sum / static_cast<double>(counted) : 0.0;
+}
+
+
+static void Screen(const Voice& voice, size_t trajectories, size_t workers, uint64_t* seed)
+{
+	const size_t k = voice.parameters_no;
+	const auto bands = OctaveBands(31.25, 16000.0);
+
+	// Trajectories, 'k + 1' points each. From a random grid point, one
+	// parameter at a time (in random order) moving by 'DELTA', up or down
+	// to stay in range
+	std::vector<double> x(trajectories * (k + 1) * k);
+	std::vector<size_t> moved(trajectories * k);
+
+	for (size_t t = 0; t < trajectories; t += 1)
+	{
+		double* base = &x[t * (k + 1) * k];
+		size_t* order = &moved[t * k];
+
+		for (size_t i = 0; i < k; i += 1)
+		{
+			base[i] = static_cast<double>(Random(seed) % LEVELS) / (LEVELS - 1.0);
+			order[i] = i;
+		}
+
+		for (size_t i = k - 1; i > 0; i -= 1)
+			std::swap(order[i], order[Random(seed) % (i + 1)]);
+
+		for (size_t s = 0; s < k; s += 1)
+		{
+			double* point = base + (s + 1) * k;
+			memcpy(point, point - k, sizeof(double) * k);
+			point[order[s]] += (point[order[s]] < 0.5) ? DELTA : -DELTA;
+		}
+	}
+
+	// Render and analyse every point
+	std::vector<Worker> state(workers);
+	std::vector<Point> points(trajectories * (k + 1));
+
+	const auto start = std::chrono::steady_clock::now();
+
+	BatchRun(points.size(), workers,
+	         [&](size_t p, size_t w)
+	         {
+		         Worker& worker = state[w];
+		         worker.values.resize(k);
+		         for (size_t i = 0; i < k; i += 1)
+		         {
+			         const Parameter& parameter = voice.parameters[i];
+			         worker.values[i] = parameter.min + x[p * k + i] * (parameter.max - parameter.min);
+		         }
+
+		         auto out = Output(worker.buffer.GetData(), worker.buffer.GetLength());
+		         voice.render_parameters(SAMPLING_FREQUENCY, Hit(), worker.values.data(), &out);
+		         Analyse(worker.buffer.GetData(), out.GetLength(), bands, &worker, &points[p]);
+	         });
+
+	const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Elementary effects
+	std::vector<double> mu(k * FEATURES_NO, 0.0);
+	std::vector<double> mu_sq(k * FEATURES_NO, 0.0);
+
+	for (size_t t = 0; t < trajectories; t += 1)
+	{
+		for (size_t s = 0; s < k; s += 1)
+		{
+			const Point& a = points[t * (k + 1) + s];
+			const Point& b = points[t * (k + 1) + s + 1];
+			const size_t i = moved[t * k + s];
+
+			for (size_t f = 0; f < FEATURES_NO; f += 1)
+			{
+				const double difference = (f == FEATURE_SPECTRUM) ? SpectrumDistance(a, b, bands.size())
+				                                                  : b.features[f] - a.features[f];
+				const double effect = fabs(difference) / DELTA;
+
+				mu[i * FEATURES_NO + f] += effect;
+				mu_sq[i * FEATURES_NO + f] += effect * effect;
+			}
+		}
+	}
+
+	const double r = static_cast<double>(trajectories);
+	for (size_t i = 0; i < k * FEATURES_NO; i += 1)
+	{
+		mu[i] /= r;
+		mu_sq[i] = sqrt(Max(mu_sq[i] / r - mu[i] * mu[i], 0.0)); // Now deviation
+	}
+
+	// Report, most influential first
+	std::vector<size_t> ranking(k);
+	for (size_t i = 0; i < k; i += 1)
+		ranking[i] = i;
+	std::sort(ranking.begin(), ranking.end(), [&](size_t a, size_t b)
+	          { return mu[a * FEATURES_NO + FEATURE_SPECTRUM] > mu[b * FEATURES_NO + FEATURE_SPECTRUM]; });
+
+	printf("%s, %zu parameters, %zu renders in %.2f s\n\n", voice.name, k, points.size(), elapsed);
+	printf("%-20s %12s %8s", "Parameter", FEATURE_NAMES[FEATURE_SPECTRUM], "Sigma");
+	for (size_t f = FEATURE_SPECTRUM + 1; f < FEATURES_NO; f += 1)
+		printf(" %12s", FEATURE_NAMES[f]);
+	printf("\n");
+
+	for (const size_t i : ranking)
+	{
+		printf("%-20s %12.2f %8.2f", voice.parameters[i].name, mu[i * FEATURES_NO + FEATURE_SPECTRUM],
+		       mu_sq[i * FEATURES_NO + FEATURE_SPECTRUM]);
+		for (size_t f = FEATURE_SPECTRUM + 1; f < FEATURES_NO; f += 1)
+			printf(" %12.2f", mu[i * FEATURES_NO + f]);
+		printf("\n");
+	}
+
+	printf("\n");
+}
+
+
+int main(int argc, const char* argv[])
+{
+	const char* voice_name = nullptr;
+	size_t trajectories = 20;
+	size_t threads = 0;
+	uint64_t seed = 1;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--trajectories") == 0 && i + 1 < argc)
+			trajectories = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = Max(static_cast<uint64_t>(strtoull(argv[++i], nullptr, 10)), static_cast<uint64_t>(1));
+		else
+			voice_name = argv[i];
+	}
+
+	bool found = false;
+	for (const Voice& voice : VOICES_606)
+	{
+		if (voice_name != nullptr && strcmp(voice.name, voice_name) != 0)
+			continue;
+
+		Screen(voice, trajectories, BatchWorkers(threads), &seed);
+		found = true;
+	}
+
+	if (found == false)
+	{
+		fprintf(stderr, "Usage: 606-sensitivity [voice] [--trajectories n] [--threads n] [--seed n]\n");
+		return 1;
+	}
+
+	return 0;
+}
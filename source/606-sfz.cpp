@@ -0,0 +1,253 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "606.hpp"
+#include "batch.hpp"
+
+#include <string>
+
+// Renders every voice in velocity layers and round robins, in parallel,
+// then writes the sfz mapping them. Round robins differ in noise seed, so
+// only voices with noise get them. With '--trace file.json' a timeline of
+// what every thread did, to open in chrome://tracing or Perfetto.
+
+
+struct SfzVoice
+{
+	const char* name; // As in 'VOICES_606'
+	const char* label;
+	int cc;
+	int cc_default;
+	int group;
+	bool noise;
+	const char* keys[3];
+};
+
+// clang-format off
+static const SfzVoice SFZ_VOICES[] = {
+    {"606-kick",       "Kick vol",       100, 64, 1, false, {"B0", "C1", nullptr}},
+    {"606-snare",      "Snare vol",      101, 64, 1, true,  {"D1", "E1", nullptr}},
+    {"606-hat-closed", "Hat closed vol", 102, 30, 2, true,  {"Gb1", "Ab1", nullptr}},
+    {"606-hat-open",   "Hat open vol",   103, 35, 2, true,  {"Bb1", nullptr, nullptr}},
+    {"606-tom-low",    "Tom low vol",    104, 64, 1, false, {"F1", "G1", "A1"}},
+    {"606-tom-high",   "Tom high vol",   105, 64, 1, false, {"B1", "C2", "D2"}},
+};
+
+static const char* SFZ_GROUPS[] = {
+    "<group> group=1 volume=-24 loop_mode=one_shot",
+    "<group> group=2 off_by=2 volume=-24 loop_mode=one_shot off_mode=normal ampeg_release=0.07", // Hats choke
+};
+// clang-format on
+
+static constexpr size_t SFZ_VOICES_NO = sizeof(SFZ_VOICES) / sizeof(SfzVoice);
+static constexpr int SFZ_GROUPS_NO = static_cast<int>(sizeof(SFZ_GROUPS) / sizeof(const char*));
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+
+
+struct Job
+{
+	const SfzVoice* voice;
+	int (*render)(double, const Hit&, Output*);
+	Hit hit;
+
+	int layer;
+	int round_robin;
+	std::string filename; // Without extension
+};
+
+
+static int WriteSfz(const std::vector<Job>& jobs, int layers, int round_robins, const char* extension,
+                    const char* filename)
+{
+	FILE* fp = fopen(filename, "w");
+	if (fp == nullptr)
+		return 1;
+
+	fprintf(fp, "// Generated by '606-sfz', %i velocity layer(s), %i round robin(s)\n\n", layers, round_robins);
+
+	// Controls
+	fprintf(fp, "<control>\n");
+	for (size_t i = 0; i < SFZ_VOICES_NO; i += 1)
+	{
+		fprintf(fp, "label_cc%i=%s\n", SFZ_VOICES[i].cc, SFZ_VOICES[i].label);
+		fprintf(fp, "set_cc%i=%i\n\n", SFZ_VOICES[i].cc, SFZ_VOICES[i].cc_default);
+	}
+
+	// Groups
+	for (int g = 0; g < SFZ_GROUPS_NO; g += 1)
+	{
+		// Samples column aligned, as we used to write it by hand
+		int sample_width = 0;
+		for (const Job& job : jobs)
+		{
+			if (job.voice->group == g + 1)
+				sample_width = Max(sample_width, static_cast<int>(job.filename.size() + strlen(extension) + 1));
+		}
+
+		fprintf(fp, "%s%s\n", (g > 0) ? "\n" : "", SFZ_GROUPS[g]);
+
+		for (size_t v = 0; v < SFZ_VOICES_NO; v += 1)
+		{
+			if (SFZ_VOICES[v].group != g + 1)
+				continue;
+
+			for (const char* const* key = SFZ_VOICES[v].keys; key < SFZ_VOICES[v].keys + 3 && *key != nullptr;
+			     key += 1)
+			{
+				for (const Job& job : jobs)
+				{
+					if (job.voice != &SFZ_VOICES[v])
+						continue;
+
+					const std::string sample = job.filename + "." + extension;
+					fprintf(fp, "<region> sample=%-*s key=%s", sample_width, sample.c_str(), *key);
+
+					if (layers > 1)
+						fprintf(fp, " lovel=%i hivel=%i", (127 * job.layer) / layers + 1,
+						        (127 * (job.layer + 1)) / layers);
+
+					if (job.voice->noise == true && round_robins > 1)
+						fprintf(fp, " seq_length=%i seq_position=%i", round_robins, job.round_robin + 1);
+
+					fprintf(fp, " volume_oncc%i=48\n", job.voice->cc);
+				}
+			}
+		}
+	}
+
+	const bool failure = (ferror(fp) != 0);
+	fclose(fp);
+
+	return (failure == true) ? 1 : 0;
+}
+
+
+int main(int argc, const char* argv[])
+{
+	// Usage: 606-sfz [--layers n] [--round-robins n] [--extension wav|flac|...] [--sfz-only]
+	//               [--threads n] [--trace file.json]
+	// Writes 'matsu-606.sfz' and, unless '--sfz-only', its samples as wav
+
+	int layers = 1;
+	int round_robins = 1;
+	const char* extension = "wav";
+	bool sfz_only = false;
+	size_t threads = 0;
+	const char* trace_filename = nullptr;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc)
+			layers = Clamp(atoi(argv[++i]), 1, 127);
+		else if (strcmp(argv[i], "--round-robins") == 0 && i + 1 < argc)
+			round_robins = Clamp(atoi(argv[++i]), 1, 64);
+		else if (strcmp(argv[i], "--extension") == 0 && i + 1 < argc)
+			extension = argv[++i];
+		else if (strcmp(argv[i], "--sfz-only") == 0)
+			sfz_only = true;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			trace_filename = argv[++i];
+		else
+		{
+			fprintf(stderr, "Usage: 606-sfz [--layers n] [--round-robins n] [--extension ext] [--sfz-only]\n"
+			                "               [--threads n] [--trace file.json]\n");
+			return 1;
+		}
+	}
+
+	if (trace_filename != nullptr)
+		TraceStart();
+
+	// One job per sample
+	std::vector<Job> jobs;
+	for (size_t v = 0; v < SFZ_VOICES_NO; v += 1)
+	{
+		int (*render)(double, const Hit&, Output*) = nullptr;
+		for (const Voice& voice : VOICES_606)
+		{
+			if (strcmp(voice.name, SFZ_VOICES[v].name) == 0)
+				render = voice.render;
+		}
+
+		const int voice_round_robins = (SFZ_VOICES[v].noise == true) ? round_robins : 1;
+
+		for (int l = 0; l < layers; l += 1)
+		{
+			for (int r = 0; r < voice_round_robins; r += 1)
+			{
+				Job job;
+				job.voice = &SFZ_VOICES[v];
+				job.render = render;
+				job.hit.velocity = static_cast<double>((127 * (l + 1)) / layers) / 127.0; // Layer top
+				job.hit.seed = static_cast<uint64_t>(r + 1);
+				job.layer = l;
+				job.round_robin = r;
+
+				job.filename = SFZ_VOICES[v].name;
+				if (layers > 1)
+					job.filename += "-v" + std::to_string(l + 1);
+				if (voice_round_robins > 1)
+					job.filename += "-rr" + std::to_string(r + 1);
+
+				jobs.push_back(job);
+			}
+		}
+	}
+
+	// Render, a buffer per worker
+	if (sfz_only == false)
+	{
+		const size_t workers = BatchWorkers(threads);
+		std::vector<RenderBuffer> buffers;
+		for (size_t w = 0; w < workers; w += 1)
+			buffers.emplace_back(static_cast<size_t>(SAMPLING_FREQUENCY) * 2);
+
+		BatchRun(jobs.size(), workers,
+		         [&](size_t j, size_t w)
+		         {
+			         const Job& job = jobs[j];
+
+			         auto out = Output(buffers[w].GetData(), buffers[w].GetLength());
+			         {
+				         MATSU_TRACE_SCOPE("Render", "render");
+				         job.render(SAMPLING_FREQUENCY, job.hit, &out);
+			         }
+
+			         ExportS24(buffers[w].GetData(), SAMPLING_FREQUENCY, out.GetLength(),
+			                   (job.filename + ".wav").c_str());
+		         });
+	}
+
+	// Sfz
+	int sfz_failure;
+	{
+		MATSU_TRACE_SCOPE("Sfz", "sfz");
+		sfz_failure = WriteSfz(jobs, layers, round_robins, extension, "matsu-606.sfz");
+	}
+
+	if (sfz_failure != 0)
+	{
+		fprintf(stderr, "Error writing 'matsu-606.sfz'\n");
+		return 1;
+	}
+
+	if (trace_filename != nullptr && TraceWrite(trace_filename) == false)
+	{
+		fprintf(stderr, "Error writing '%s'\n", trace_filename);
+		return 1;
+	}
+
+	return 0;
+}
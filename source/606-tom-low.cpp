@@ -10,60 +10,10 @@ This Source Code Form is "Incompatible With Secondary Licenses", as
 defined by the Mozilla Public License, v. 2.0.
 */
 
-#include "matsu.hpp"
+#include "606.hpp"
 
 
-static int RenderTomLow(double sampling_frequency, double** out)
+int main(int argc, const char* argv[])
 {
-	auto envelope = AdEnvelope(0.0, 430.0, sampling_frequency);
-
-	auto oscillator = Oscillator(180.0, 118.0, 0.15, 0.0, 430.0, sampling_frequency); // 150, 180 / 115, 120
-
-	// auto noise = NoiseGenerator();
-	// auto hp = TwoPolesFilter<FilterType::Highpass>(2200.0, 0.75, sampling_frequency);
-	// auto lp1 = OnePoleFilter<FilterType::Lowpass>(2200.0, sampling_frequency);
-	// auto lp2 = TwoPolesFilter<FilterType::Lowpass>(16000.0, 0.5, sampling_frequency);
-
-	// const double noise_gain = 0.0;
-	const double oscillator_gain = 1.0;
-
-	// Render
-	for (int x = 0; x < envelope.GetTotalSamples(); x += 1)
-	{
-		const double e = envelope.Get(
-		    x,                          //
-		    [](double x) { return x; }, //
-		    [](double x) { return ExponentialEasing(x, 8.0); });
-
-		const double o = oscillator.Step( //
-		    [](double x) { return 1.0 - ExponentialEasing(1.0 - x, 8.0); });
-
-		// double n = noise.Step();
-		// n = hp.Step(n);
-		// n = lp2.Step(n);
-		// n = lp1.Step(n);
-
-		const double mix = (o * oscillator_gain /*+ n * noise_gain*/) * e;
-
-		**out = mix;
-		*out += 1;
-	}
-
-	// Bye!
-	return 0;
-}
-
-
-static constexpr double SAMPLING_FREQUENCY = 44100.0;
-static double render_buffer[static_cast<size_t>(SAMPLING_FREQUENCY) * 2];
-
-int main()
-{
-	double* cursor = render_buffer;
-	RenderTomLow(SAMPLING_FREQUENCY, &cursor);
-
-	ExportS24(render_buffer, SAMPLING_FREQUENCY, static_cast<size_t>(cursor - render_buffer), "606-tom-low.wav");
-	ExportF64(render_buffer, SAMPLING_FREQUENCY, static_cast<size_t>(cursor - render_buffer), "606-tom-low-64.wav");
-
-	return 0;
+	return VoiceMain("606-tom-low", RenderTomLow, argc, argv);
 }
@@ -0,0 +1,732 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+#ifndef MATSU_606_HPP
+#define MATSU_606_HPP
+
+#include "matsu.hpp"
+#include "profile.hpp"
+#include "stream.hpp"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+struct Hit
+{
+	double velocity = 1.0; // Changes timbre, level left to the sampler velocity tracking
+	uint64_t seed = 1;     // Noise
+};
+
+inline double Accent(double velocity, double depth)
+{
+	// Exactly one at full velocity, renders there stay as they always were
+	return 1.0 - (1.0 - velocity) * depth;
+}
+
+
+struct Parameter
+{
+	const char* name;
+	double value; // Default, what renders always used
+	double min;   // Range, for tools exploring them
+	double max;
+};
+
+inline std::vector<double> ParameterDefaults(const Parameter* parameters, size_t parameters_no)
+{
+	std::vector<double> values(parameters_no);
+	for (size_t i = 0; i < parameters_no; i += 1)
+		values[i] = parameters[i].value;
+
+	return values;
+}
+
+
+// clang-format off
+enum KickParameter
+{
+	KICK_CLICK_ATTACK, KICK_CLICK_DECAY, KICK_CLICK_E1, KICK_CLICK_E2, KICK_CLICK_E3, KICK_CLICK_E4,
+	KICK_DECAY_1, KICK_DECAY_2, KICK_FREQUENCY_1, KICK_FREQUENCY_2, KICK_FEEDBACK_2, KICK_EASING,
+	KICK_GAIN_1, KICK_GAIN_2, KICK_PARAMETERS_NO
+};
+
+static const Parameter KICK_PARAMETERS[KICK_PARAMETERS_NO] = {
+	{"click_attack",  49.0,   10.0, 150.0}, // In samples
+	{"click_decay",   64.0,   10.0, 200.0}, // Ditto
+	{"click_e1",      0.7,    0.1,  4.0},
+	{"click_e2",      2.35,   0.1,  8.0},
+	{"click_e3",      1.14,   0.1,  8.0},
+	{"click_e4",      3.0,    0.1,  8.0},
+	{"decay_1",       300.0,  50.0, 1000.0},
+	{"decay_2",       70.0,   10.0, 500.0},
+	{"frequency_1",   60.0,   30.0, 120.0},
+	{"frequency_2",   120.0,  60.0, 240.0},
+	{"feedback_2",    0.1,    0.0,  0.9},
+	{"easing",        8.0,    1.0,  16.0},
+	{"gain_1",        0.8,    0.0,  1.0},
+	{"gain_2",        0.4,    0.0,  1.0},
+};
+// clang-format on
+
+template <typename T, unsigned K = 0>
+int RenderKick(double sampling_frequency, const Hit& hit, const T* p, BasicOutput<T>* out)
+{
+	// In whole samples, no derivatives
+	const int click_attack = static_cast<int>(Value(p[KICK_CLICK_ATTACK]));
+	const int click_decay = static_cast<int>(Value(p[KICK_CLICK_DECAY]));
+
+	auto click = BasicAdEnvelope<T>(SamplesToMilliseconds(click_attack, sampling_frequency),
+	                                SamplesToMilliseconds(click_decay, sampling_frequency), sampling_frequency);
+
+	auto envelope1 = BasicAdEnvelope<T>(0.0, p[KICK_DECAY_1], sampling_frequency);
+	auto envelope2 = BasicAdEnvelope<T>(0.0, p[KICK_DECAY_2], sampling_frequency);
+
+	auto oscillator1 = BasicOscillator<T, K>(p[KICK_FREQUENCY_1], p[KICK_FREQUENCY_1], 0.0, 0.0, p[KICK_DECAY_1],
+	                                         sampling_frequency);
+	auto oscillator2 = BasicOscillator<T, K>(p[KICK_FREQUENCY_2], p[KICK_FREQUENCY_2], p[KICK_FEEDBACK_2],
+	                                         p[KICK_FEEDBACK_2], p[KICK_DECAY_2], sampling_frequency);
+
+	const T oscillator1_gain = p[KICK_GAIN_1];
+	const T oscillator2_gain = p[KICK_GAIN_2] * Accent(hit.velocity, 0.5);
+	const double click_gain = Accent(hit.velocity, 0.6);
+	const auto easing = BasicEasingCurve<T, K>(p[KICK_EASING]);
+
+	// Render
+	for (int x = 0; x < click.GetTotalSamples(); x += 1)
+	{
+		MATSU_PROFILE_SCOPE("Click");
+
+		const T e1 = p[KICK_CLICK_E1];
+		const T e2 = p[KICK_CLICK_E2];
+		const T e3 = p[KICK_CLICK_E3];
+		const T e4 = p[KICK_CLICK_E4];
+
+		const T signal = click.Get(
+		    x,                               //
+		    [&](T x) { return pow(x, e1); }, //
+		    [&](T x) { return pow(x, e3 + (e2 - e3) * pow(x, e4)); });
+
+		out->Put(-signal * click_gain);
+	}
+
+	for (int x = 0; x < Max(envelope1.GetTotalSamples(), envelope2.GetTotalSamples()); x += 1)
+	{
+		// Envelopes
+		T e1, e2;
+		{
+			MATSU_PROFILE_SCOPE("Envelopes");
+
+			e1 = envelope1.Get(x, [](T x) { return x; }, easing);
+			e2 = envelope2.Get(x, [](T x) { return x; }, easing);
+		}
+
+		// Oscillators
+		T o1, o2;
+		{
+			MATSU_PROFILE_SCOPE("Oscillators");
+
+			o1 = oscillator1.Step([&](T x) { return 1.0 - easing(1.0 - x); });
+			o2 = oscillator2.Step([&](T x) { return 1.0 - easing(1.0 - x); });
+		}
+
+		const T mix = (o1 * e1 * oscillator1_gain) + (o2 * e2 * oscillator2_gain);
+
+		out->Put(mix);
+	}
+
+	// Bye!
+	return 0;
+}
+
+
+// clang-format off
+enum SnareParameter
+{
+	SNARE_ATTACK, SNARE_OSCILLATOR_DECAY, SNARE_NOISE_DECAY, SNARE_FREQUENCY_A, SNARE_FREQUENCY_B,
+	SNARE_OSCILLATOR_EASING, SNARE_NOISE_EASING, SNARE_SWEEP_EASING, SNARE_NOISE_FREQUENCY, SNARE_NOISE_Q,
+	SNARE_NOISE_LOWPASS, SNARE_NOISE_LOWPASS_Q, SNARE_NOISE_GAIN, SNARE_OSCILLATOR_GAIN, SNARE_PARAMETERS_NO
+};
+
+static const Parameter SNARE_PARAMETERS[SNARE_PARAMETERS_NO] = {
+	{"attack",            2.0,     0.0,    10.0},
+	{"oscillator_decay",  150.0,   30.0,   500.0},
+	{"noise_decay",       150.0,   30.0,   500.0},
+	{"frequency_a",       320.0,   150.0,  500.0}, // 340
+	{"frequency_b",       190.0,   100.0,  400.0}, // 170
+	{"oscillator_easing", 8.0,     1.0,    16.0},
+	{"noise_easing",      9.0,     1.0,    16.0},  // 8, 11
+	{"sweep_easing",      8.0,     1.0,    16.0},
+	{"noise_frequency",   2200.0,  500.0,  8000.0}, // Detuned 3.5 semitones up
+	{"noise_q",           0.75,    0.3,    4.0},
+	{"noise_lowpass",     16000.0, 4000.0, 20000.0},
+	{"noise_lowpass_q",   0.5,     0.3,    4.0},
+	{"noise_gain",        0.9,     0.0,    1.5},   // 0.9, 1.0
+	{"oscillator_gain",   0.7,     0.0,    1.5},   // 0.7
+};
+// clang-format on
+
+template <typename T, unsigned K = 0>
+int RenderSnare(double sampling_frequency, const Hit& hit, const T* p, BasicOutput<T>* out)
+{
+	auto envelope_o =
+	    BasicAdEnvelope<T>(p[SNARE_ATTACK], p[SNARE_OSCILLATOR_DECAY] - p[SNARE_ATTACK], sampling_frequency);
+	auto envelope_n = BasicAdEnvelope<T>(p[SNARE_ATTACK], p[SNARE_NOISE_DECAY] - p[SNARE_ATTACK], sampling_frequency);
+
+	auto oscillator = BasicOscillator<T, K>(p[SNARE_FREQUENCY_A], p[SNARE_FREQUENCY_B], 0.0, 0.0,
+	                                        p[SNARE_OSCILLATOR_DECAY], sampling_frequency);
+
+	const T noise_frequency = p[SNARE_NOISE_FREQUENCY] * SemitoneDetune(3.5);
+	auto noise = NoiseGenerator(hit.seed);
+	auto hp = TwoPolesFilter<FilterType::Highpass, T>(noise_frequency, p[SNARE_NOISE_Q], sampling_frequency);
+	auto lp1 = OnePoleFilter<FilterType::Lowpass, T>(noise_frequency, sampling_frequency);
+	auto lp2 =
+	    TwoPolesFilter<FilterType::Lowpass, T>(p[SNARE_NOISE_LOWPASS], p[SNARE_NOISE_LOWPASS_Q], sampling_frequency);
+
+	const T noise_gain = p[SNARE_NOISE_GAIN] * Accent(hit.velocity, 0.4);
+	const T oscillator_gain = p[SNARE_OSCILLATOR_GAIN];
+
+	const auto oscillator_easing = BasicEasingCurve<T, K>(p[SNARE_OSCILLATOR_EASING]);
+	const auto noise_easing = BasicEasingCurve<T, K>(p[SNARE_NOISE_EASING]);
+	const auto sweep_easing = BasicEasingCurve<T, K>(p[SNARE_SWEEP_EASING]);
+
+	// Render
+	for (int x = 0; x < Max(envelope_o.GetTotalSamples(), envelope_n.GetTotalSamples()); x += 1)
+	{
+		// Envelopes
+		T e_o, e_n;
+		{
+			MATSU_PROFILE_SCOPE("Envelopes");
+
+			e_o = envelope_o.Get(x, [](T x) { return x; }, oscillator_easing);
+			e_n = envelope_n.Get(x, [](T x) { return x; }, noise_easing);
+		}
+
+		// Oscillator
+		T o;
+		{
+			MATSU_PROFILE_SCOPE("Oscillator");
+
+			o = oscillator.Step([&](T x) { return 1.0 - sweep_easing(1.0 - x); });
+		}
+
+		// Noise
+		T n;
+		{
+			MATSU_PROFILE_SCOPE("Noise, filters");
+
+			n = noise.Step();
+			n = hp.Step(n);
+			n = lp2.Step(n);
+			n = lp1.Step(n);
+		}
+
+		const T mix = (o * e_o * oscillator_gain) + (n * e_n * noise_gain);
+
+		out->Put(mix);
+	}
+
+	// Bye!
+	return 0;
+}
+
+
+// clang-format off
+enum HatParameter
+{
+	// Metallic signal, common to both hats
+	HAT_SQUARE_1, HAT_SQUARE_2, HAT_SQUARE_3, HAT_SQUARE_4, HAT_SQUARE_5, HAT_SQUARE_6,
+	HAT_CLINK_1, HAT_CLINK_2, HAT_CLINK_3, HAT_CLINK_4, HAT_CLINK_5, HAT_CLINK_6,
+	HAT_BANDPASS_FREQUENCY, HAT_BANDPASS_LOW_Q, HAT_BANDPASS_HIGH_Q, HAT_HIGHPASS, HAT_LOWPASS,
+	HAT_METALLIC_NO
+};
+
+#define MATSU_HAT_METALLIC_PARAMETERS \
+	{"square_1",           619.0,  300.0,  1200.0}, \
+	{"square_2",           437.0,  200.0,  900.0}, \
+	{"square_3",           415.0,  200.0,  900.0}, \
+	{"square_4",           365.0,  150.0,  800.0}, \
+	{"square_5",           306.0,  150.0,  600.0}, \
+	{"square_6",           245.0,  100.0,  500.0}, \
+	{"clink_1",            7502.0, 3000.0, 15000.0}, \
+	{"clink_2",            6149.0, 3000.0, 12000.0}, \
+	{"clink_3",            5552.0, 2500.0, 11000.0}, \
+	{"clink_4",            4746.0, 2000.0, 9500.0}, \
+	{"clink_5",            3363.0, 1500.0, 7000.0}, \
+	{"clink_6",            1094.0, 500.0,  2200.0}, \
+	{"bandpass_frequency", 6600.0, 3000.0, 12000.0}, /* 6000, 6700 */ \
+	{"bandpass_low_q",     0.6,    0.3,    4.0}, \
+	{"bandpass_high_q",    0.5,    0.3,    4.0}, \
+	{"highpass",           6000.0, 2000.0, 12000.0}, \
+	{"lowpass",            7800.0, 3000.0, 18000.0}
+
+enum HatClosedParameter
+{
+	HAT_CLOSED_DECAY = HAT_METALLIC_NO, HAT_CLOSED_EASING, HAT_CLOSED_DISTORTION, HAT_CLOSED_ASYMMETRY,
+	HAT_CLOSED_TSS_GAIN, HAT_CLOSED_CLINK_GAIN, HAT_CLOSED_NOISE_GAIN, HAT_CLOSED_PARAMETERS_NO
+};
+
+static const Parameter HAT_CLOSED_PARAMETERS[HAT_CLOSED_PARAMETERS_NO] = {
+	MATSU_HAT_METALLIC_PARAMETERS,
+	{"decay",              140.0,  30.0,   500.0},
+	{"easing",             9.0,    1.0,    20.0},  // 10, 20
+	{"distortion",         -6.0,   -12.0,  -1.0},
+	{"asymmetry",          0.5,    0.1,    1.0},
+	{"tss_gain",           3.0,    0.0,    6.0},
+	{"clink_gain",         0.72,   0.0,    2.0},
+	{"noise_gain",         1.2,    0.0,    3.0},
+};
+
+enum HatOpenParameter
+{
+	HAT_OPEN_LONG_DECAY = HAT_METALLIC_NO, HAT_OPEN_SHORT_DECAY, HAT_OPEN_LONG_EASING, HAT_OPEN_SHORT_EASING,
+	HAT_OPEN_LONG_DISTORTION, HAT_OPEN_LONG_ASYMMETRY, HAT_OPEN_SHORT_DISTORTION, HAT_OPEN_SHORT_ASYMMETRY,
+	HAT_OPEN_LONG_GAIN, HAT_OPEN_SHORT_GAIN, HAT_OPEN_CLINK_GAIN, HAT_OPEN_NOISE_GAIN, HAT_OPEN_PARAMETERS_NO
+};
+
+static const Parameter HAT_OPEN_PARAMETERS[HAT_OPEN_PARAMETERS_NO] = {
+	MATSU_HAT_METALLIC_PARAMETERS,
+	{"long_decay",         1500.0, 300.0,  3000.0},
+	{"short_decay",        500.0,  100.0,  1500.0},
+	{"long_easing",        2.5,    1.0,    20.0},
+	{"short_easing",       9.0,    1.0,    20.0},  // 10, 20
+	{"long_distortion",    -8.0,   -12.0,  -1.0},
+	{"long_asymmetry",     0.3,    0.1,    1.0},
+	{"short_distortion",   -6.0,   -12.0,  -1.0},
+	{"short_asymmetry",    0.5,    0.1,    1.0},
+	{"long_gain",          1.85,   0.0,    4.0},   // All four scaled by 0.75
+	{"short_gain",         1.4,    0.0,    4.0},
+	{"clink_gain",         1.0,    0.0,    2.0},
+	{"noise_gain",         0.8,    0.0,    2.0},
+};
+
+#undef MATSU_HAT_METALLIC_PARAMETERS
+// clang-format on
+
+template <typename T, unsigned K> class HatMetallic
+{
+	// Six square oscillators, a clink of six sines, through a peculiar
+	// bandpass (12db lp and 24db hp, components), then clipped. Squares
+	// carry no derivatives, being flat but at their edges
+  public:
+	HatMetallic(double sampling_frequency, const T* p)
+	    : m_squares{{Value(p[HAT_SQUARE_1]), sampling_frequency}, {Value(p[HAT_SQUARE_2]), sampling_frequency},
+	                {Value(p[HAT_SQUARE_3]), sampling_frequency}, {Value(p[HAT_SQUARE_4]), sampling_frequency},
+	                {Value(p[HAT_SQUARE_5]), sampling_frequency}, {Value(p[HAT_SQUARE_6]), sampling_frequency}},
+	      m_clink{{p[HAT_CLINK_1], p[HAT_CLINK_1], 0.0, 0.0, 1500.0, sampling_frequency},
+	              {p[HAT_CLINK_2], p[HAT_CLINK_2], 0.0, 0.0, 1500.0, sampling_frequency},
+	              {p[HAT_CLINK_3], p[HAT_CLINK_3], 0.0, 0.0, 1500.0, sampling_frequency},
+	              {p[HAT_CLINK_4], p[HAT_CLINK_4], 0.0, 0.0, 1500.0, sampling_frequency},
+	              {p[HAT_CLINK_5], p[HAT_CLINK_5], 0.0, 0.0, 1500.0, sampling_frequency},
+	              {p[HAT_CLINK_6], p[HAT_CLINK_6], 0.0, 0.0, 1500.0, sampling_frequency}},
+	      m_bp_a(p[HAT_BANDPASS_FREQUENCY], p[HAT_BANDPASS_LOW_Q], sampling_frequency),
+	      m_bp_b(p[HAT_BANDPASS_FREQUENCY], p[HAT_BANDPASS_HIGH_Q], sampling_frequency),
+	      m_bp_c(p[HAT_BANDPASS_FREQUENCY], p[HAT_BANDPASS_HIGH_Q], sampling_frequency)
+	{
+	}
+
+	T Step(T clink_gain, double drive)
+	{
+		T metallic;
+
+		// Square oscillators
+		{
+			MATSU_PROFILE_SCOPE("Square oscillators");
+
+			metallic = m_squares[0].Step() + m_squares[1].Step() + m_squares[2].Step() //
+			           + m_squares[3].Step() + m_squares[4].Step() + m_squares[5].Step();
+			metallic /= 6.0;
+		}
+
+		// Clink
+		{
+			MATSU_PROFILE_SCOPE("Clink");
+
+			const auto easing = [](T x) { return x; };
+			metallic += (m_clink[0].Step(easing) + m_clink[1].Step(easing) + m_clink[2].Step(easing) + //
+			             m_clink[3].Step(easing) + m_clink[4].Step(easing) + m_clink[5].Step(easing)) *
+			            0.05 * clink_gain;
+		}
+
+		// Bandpass
+		{
+			MATSU_PROFILE_SCOPE("Bandpass");
+
+			metallic = m_bp_b.Step(m_bp_a.Step(metallic));
+			metallic = m_bp_c.Step(metallic);
+			metallic = Clamp(metallic * 8.0 * drive, T(-1.0), T(1.0)); // Normalize and clip it
+		}
+
+		return metallic;
+	}
+
+  private:
+	SquareOscillator m_squares[6];
+	BasicOscillator<T, K> m_clink[6];
+
+	TwoPolesFilter<FilterType::Lowpass, T> m_bp_a;
+	TwoPolesFilter<FilterType::Highpass, T> m_bp_b;
+	TwoPolesFilter<FilterType::Highpass, T> m_bp_c;
+};
+
+template <typename T, unsigned K = 0>
+int RenderHatClosed(double sampling_frequency, const Hit& hit, const T* p, BasicOutput<T>* out)
+{
+	auto envelope = BasicAdEnvelope<T>(0.0, p[HAT_CLOSED_DECAY], sampling_frequency);
+	auto metallic_signal = HatMetallic<T, K>(sampling_frequency, p);
+	auto noise = NoiseGenerator(hit.seed);
+
+	// These two after envelope
+	auto hp = TwoPolesFilter<FilterType::Highpass, T>(p[HAT_HIGHPASS], 0.5, sampling_frequency);
+	auto lp = OnePoleFilter<FilterType::Lowpass, T>(p[HAT_LOWPASS], sampling_frequency); // Too digital otherwise
+
+	const T tss_gain = p[HAT_CLOSED_TSS_GAIN];
+	const T clink_gain = p[HAT_CLOSED_CLINK_GAIN];
+	const T noise_gain = p[HAT_CLOSED_NOISE_GAIN];
+	const double drive = Accent(hit.velocity, 0.5);
+
+	const auto easing = BasicEasingCurve<T, K>(p[HAT_CLOSED_EASING]);
+	const auto distortion = BasicDistortionCurve<T, K>(p[HAT_CLOSED_DISTORTION], p[HAT_CLOSED_ASYMMETRY]);
+
+	// Render
+	for (int x = 0; x < envelope.GetTotalSamples(); x += 1)
+	{
+		// Envelope
+		T e;
+		{
+			MATSU_PROFILE_SCOPE("Envelope");
+
+			e = envelope.Get(x, [](T x) { return x; }, easing);
+		}
+
+		// Metallic signal
+		const T metallic = metallic_signal.Step(clink_gain, drive);
+
+		// Tsss
+		T tss;
+		{
+			MATSU_PROFILE_SCOPE("Distortion");
+			tss = distortion(metallic);
+		}
+
+		// Mix
+		T mix;
+		{
+			MATSU_PROFILE_SCOPE("Final filters");
+			mix = lp.Step(hp.Step((tss * e * tss_gain)) + (noise.Step() * 0.06 * e * noise_gain));
+		}
+
+		out->Put(Clamp(mix, T(-1.0), T(1.0)));
+	}
+
+	// Bye!
+	return 0;
+}
+
+
+template <typename T, unsigned K = 0>
+int RenderHatOpen(double sampling_frequency, const Hit& hit, const T* p, BasicOutput<T>* out)
+{
+	auto envelope_long = BasicAdEnvelope<T>(0.0, p[HAT_OPEN_LONG_DECAY], sampling_frequency);
+	auto envelope_short = BasicAdEnvelope<T>(0.0, p[HAT_OPEN_SHORT_DECAY], sampling_frequency);
+	auto metallic_signal = HatMetallic<T, K>(sampling_frequency, p);
+	auto noise = NoiseGenerator(hit.seed);
+
+	// These two after envelope
+	auto hp = TwoPolesFilter<FilterType::Highpass, T>(p[HAT_HIGHPASS], 0.5, sampling_frequency);
+	auto lp = OnePoleFilter<FilterType::Lowpass, T>(p[HAT_LOWPASS], sampling_frequency); // Too digital otherwise
+
+	const T short_gain = p[HAT_OPEN_SHORT_GAIN] * 0.75;
+	const T long_gain = p[HAT_OPEN_LONG_GAIN] * 0.75;
+	const T clink_gain = p[HAT_OPEN_CLINK_GAIN] * 0.75;
+	const T noise_gain = p[HAT_OPEN_NOISE_GAIN] * 0.75;
+	const double drive = Accent(hit.velocity, 0.5);
+
+	const auto long_easing = BasicEasingCurve<T, K>(p[HAT_OPEN_LONG_EASING]);
+	const auto short_easing = BasicEasingCurve<T, K>(p[HAT_OPEN_SHORT_EASING]);
+	const auto long_distortion = BasicDistortionCurve<T, K>(p[HAT_OPEN_LONG_DISTORTION], p[HAT_OPEN_LONG_ASYMMETRY]);
+	const auto short_distortion =
+	    BasicDistortionCurve<T, K>(p[HAT_OPEN_SHORT_DISTORTION], p[HAT_OPEN_SHORT_ASYMMETRY]);
+
+	// Render
+	for (int x = 0; x < Max(envelope_long.GetTotalSamples(), envelope_short.GetTotalSamples()); x += 1)
+	{
+		// Envelopes
+		T e_l, e_s;
+		{
+			MATSU_PROFILE_SCOPE("Envelopes");
+
+			e_l = envelope_long.Get(x, [](T x) { return x; }, long_easing);
+			e_s = envelope_short.Get(x, [](T x) { return x; }, short_easing);
+		}
+
+		// Metallic signal
+		const T metallic = metallic_signal.Step(clink_gain, drive);
+
+		// Long tsss
+		T l;
+		{
+			MATSU_PROFILE_SCOPE("Distortion");
+			l = long_distortion(metallic);
+		}
+
+		// Short tsss
+		T s;
+		{
+			MATSU_PROFILE_SCOPE("Distortion");
+			s = short_distortion(metallic);
+		}
+
+		// Mix
+		T mix;
+		{
+			MATSU_PROFILE_SCOPE("Final filters");
+
+			// Noise drawn in this order whatever the sample type
+			const double n_s = noise.Step();
+			const double n_l = noise.Step();
+
+			mix = lp.Step(hp.Step((l * e_l * long_gain) + (s * e_s * short_gain)) + (n_s * 0.06 * noise_gain * e_s) +
+			              (n_l * 0.00125 * noise_gain * e_l));
+		}
+
+		out->Put(Clamp(mix, T(-1.0), T(1.0)));
+	}
+
+	// Bye!
+	return 0;
+}
+
+
+// clang-format off
+enum TomParameter
+{
+	TOM_DECAY, TOM_FREQUENCY_A, TOM_FREQUENCY_B, TOM_FEEDBACK, TOM_ENVELOPE_EASING, TOM_SWEEP_EASING, TOM_GAIN,
+	TOM_PARAMETERS_NO
+};
+
+static const Parameter TOM_LOW_PARAMETERS[TOM_PARAMETERS_NO] = {
+	{"decay",           430.0, 100.0, 1000.0},
+	{"frequency_a",     180.0, 80.0,  300.0},  // 150, 180
+	{"frequency_b",     118.0, 60.0,  250.0},  // 115, 120
+	{"feedback",        0.15,  0.0,   0.9},
+	{"envelope_easing", 8.0,   1.0,   16.0},
+	{"sweep_easing",    8.0,   1.0,   16.0},
+	{"gain",            1.0,   0.0,   1.0},
+};
+
+static const Parameter TOM_HIGH_PARAMETERS[TOM_PARAMETERS_NO] = {
+	{"decay",           280.0, 100.0, 1000.0},
+	{"frequency_a",     240.0, 100.0, 400.0},
+	{"frequency_b",     190.0, 80.0,  350.0},
+	{"feedback",        0.15,  0.0,   0.9},
+	{"envelope_easing", 8.0,   1.0,   16.0},
+	{"sweep_easing",    8.0,   1.0,   16.0},
+	{"gain",            1.0,   0.0,   1.0},
+};
+// clang-format on
+
+template <typename T, unsigned K = 0>
+int RenderTom(double sampling_frequency, const Hit& hit, const T* p, BasicOutput<T>* out)
+{
+	auto envelope = BasicAdEnvelope<T>(0.0, p[TOM_DECAY], sampling_frequency);
+
+	const T feedback = p[TOM_FEEDBACK] * Accent(hit.velocity, 0.6);
+	auto oscillator =
+	    BasicOscillator<T, K>(p[TOM_FREQUENCY_A], p[TOM_FREQUENCY_B], feedback, 0.0, p[TOM_DECAY], sampling_frequency);
+
+	// auto noise = NoiseGenerator();
+	// auto hp = TwoPolesFilter<FilterType::Highpass>(2200.0, 0.75, sampling_frequency);
+	// auto lp1 = OnePoleFilter<FilterType::Lowpass>(2200.0, sampling_frequency);
+	// auto lp2 = TwoPolesFilter<FilterType::Lowpass>(16000.0, 0.5, sampling_frequency);
+
+	// const double noise_gain = 0.0;
+	const T oscillator_gain = p[TOM_GAIN];
+
+	const auto envelope_easing = BasicEasingCurve<T, K>(p[TOM_ENVELOPE_EASING]);
+	const auto sweep_easing = BasicEasingCurve<T, K>(p[TOM_SWEEP_EASING]);
+
+	// Render
+	for (int x = 0; x < envelope.GetTotalSamples(); x += 1)
+	{
+		// Envelope
+		T e;
+		{
+			MATSU_PROFILE_SCOPE("Envelope");
+
+			e = envelope.Get(x, [](T x) { return x; }, envelope_easing);
+		}
+
+		// Oscillator
+		T o;
+		{
+			MATSU_PROFILE_SCOPE("Oscillator");
+
+			o = oscillator.Step([&](T x) { return 1.0 - sweep_easing(1.0 - x); });
+		}
+
+		// double n = noise.Step();
+		// n = hp.Step(n);
+		// n = lp2.Step(n);
+		// n = lp1.Step(n);
+
+		const T mix = (o * oscillator_gain /*+ n * noise_gain*/) * e;
+
+		out->Put(mix);
+	}
+
+	// Bye!
+	return 0;
+}
+
+
+// With default parameters
+// clang-format off
+#define MATSU_DEFAULT_RENDER(name, render, parameters, parameters_no)            \
+	template <unsigned K = 0>                                                    \
+	inline int name(double sampling_frequency, const Hit& hit, Output* out)      \
+	{                                                                            \
+		static const std::vector<double> p = ParameterDefaults(parameters, parameters_no); \
+		return render<double, K>(sampling_frequency, hit, p.data(), out);        \
+	}
+
+MATSU_DEFAULT_RENDER(RenderKick,      RenderKick,      KICK_PARAMETERS,       KICK_PARAMETERS_NO)
+MATSU_DEFAULT_RENDER(RenderSnare,     RenderSnare,     SNARE_PARAMETERS,      SNARE_PARAMETERS_NO)
+MATSU_DEFAULT_RENDER(RenderHatClosed, RenderHatClosed, HAT_CLOSED_PARAMETERS, HAT_CLOSED_PARAMETERS_NO)
+MATSU_DEFAULT_RENDER(RenderHatOpen,   RenderHatOpen,   HAT_OPEN_PARAMETERS,   HAT_OPEN_PARAMETERS_NO)
+MATSU_DEFAULT_RENDER(RenderTomLow,    RenderTom,       TOM_LOW_PARAMETERS,    TOM_PARAMETERS_NO)
+MATSU_DEFAULT_RENDER(RenderTomHigh,   RenderTom,       TOM_HIGH_PARAMETERS,   TOM_PARAMETERS_NO)
+
+#undef MATSU_DEFAULT_RENDER
+// clang-format on
+
+
+enum class Renderer
+{
+	Kick,
+	Snare,
+	HatClosed,
+	HatOpen,
+	Tom
+};
+
+struct Voice
+{
+	const char* name;
+	int (*render)(double sampling_frequency, const Hit& hit, Output* out); // Default parameters
+
+	int (*render_parameters)(double sampling_frequency, const Hit& hit, const double* parameters, Output* out);
+	Renderer renderer; // The same, for 'RenderVoice()'
+	const Parameter* parameters;
+	size_t parameters_no;
+};
+
+// clang-format off
+static const Voice VOICES_606[] = {
+	{"606-kick",       RenderKick,      RenderKick,      Renderer::Kick,
+	 KICK_PARAMETERS,       KICK_PARAMETERS_NO},
+	{"606-snare",      RenderSnare,     RenderSnare,     Renderer::Snare,
+	 SNARE_PARAMETERS,      SNARE_PARAMETERS_NO},
+	{"606-hat-closed", RenderHatClosed, RenderHatClosed, Renderer::HatClosed,
+	 HAT_CLOSED_PARAMETERS, HAT_CLOSED_PARAMETERS_NO},
+	{"606-hat-open",   RenderHatOpen,   RenderHatOpen,   Renderer::HatOpen,
+	 HAT_OPEN_PARAMETERS,   HAT_OPEN_PARAMETERS_NO},
+	{"606-tom-low",    RenderTomLow,    RenderTom,       Renderer::Tom,
+	 TOM_LOW_PARAMETERS,    TOM_PARAMETERS_NO},
+	{"606-tom-high",   RenderTomHigh,   RenderTom,       Renderer::Tom,
+	 TOM_HIGH_PARAMETERS,   TOM_PARAMETERS_NO},
+};
+// clang-format on
+
+template <typename T>
+int RenderVoice(const Voice& voice, double sampling_frequency, const Hit& hit, const T* p, BasicOutput<T>* out)
+{
+	// Same as 'render_parameters', with another sample type ('Dual' to
+	// get derivatives). Returns 1 on an unknown renderer
+	switch (voice.renderer)
+	{
+	case Renderer::Kick: return RenderKick(sampling_frequency, hit, p, out);
+	case Renderer::Snare: return RenderSnare(sampling_frequency, hit, p, out);
+	case Renderer::HatClosed: return RenderHatClosed(sampling_frequency, hit, p, out);
+	case Renderer::HatOpen: return RenderHatOpen(sampling_frequency, hit, p, out);
+	case Renderer::Tom: return RenderTom(sampling_frequency, hit, p, out);
+	}
+
+	return 1;
+}
+
+
+inline int VoiceMain(const char* name, int (*render)(double, const Hit&, Output*), int argc, const char* argv[])
+{
+	// Usage: 606-voice [--stdout] [--raw] [--format s16|s24|f32|f64] [--velocity 0-1] [--seed n]
+	// Without '--stdout' writes 'voice.wav' (s24) and 'voice-64.wav'
+
+	static constexpr double SAMPLING_FREQUENCY = 44100.0;
+	static double render_buffer[static_cast<size_t>(SAMPLING_FREQUENCY) * 2];
+
+	bool to_stdout = false;
+	bool raw = false;
+	StreamFormat format = StreamFormat::S24;
+	Hit hit;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--stdout") == 0)
+			to_stdout = true;
+		else if (strcmp(argv[i], "--raw") == 0)
+			raw = true;
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && StreamFormatFromName(argv[i + 1], &format) == true)
+			i += 1;
+		else if (strcmp(argv[i], "--velocity") == 0 && i + 1 < argc)
+			hit.velocity = Clamp(atof(argv[++i]), 0.0, 1.0);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			hit.seed = static_cast<uint64_t>(strtoull(argv[++i], nullptr, 10));
+		else
+		{
+			fprintf(stderr, "Usage: %s [--stdout] [--raw] [--format s16|s24|f32|f64] [--velocity 0-1] [--seed n]\n",
+			        name);
+			return 1;
+		}
+	}
+
+	// Stream
+	if (to_stdout == true)
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		auto stream = Stream(stdout, format, SAMPLING_FREQUENCY, (raw == false));
+		auto out = stream.GetOutput();
+
+		render(SAMPLING_FREQUENCY, hit, &out);
+		out.Flush();
+
+		return (stream.Failed() == true) ? 1 : 0;
+	}
+
+	// Files
+	auto out = Output(render_buffer, sizeof(render_buffer) / sizeof(double));
+	render(SAMPLING_FREQUENCY, hit, &out);
+
+	char filename[256];
+	snprintf(filename, sizeof(filename), "%s.wav", name);
+	ExportS24(render_buffer, SAMPLING_FREQUENCY, out.GetLength(), filename);
+
+	snprintf(filename, sizeof(filename), "%s-64.wav", name);
+	ExportF64(render_buffer, SAMPLING_FREQUENCY, out.GetLength(), filename);
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_ALLOCATION_HPP
+#define MATSU_ALLOCATION_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+// Heap allocations per thread, counted by replacing global 'operator new'
+// (what containers and 'std::function' go through, direct 'malloc()'
+// calls go unseen). Only with 'MATSU_ALLOCATION_TRACKING' defined, and
+// then in a single translation unit of a program, replacements being
+// program wide. Otherwise counts stay at zero and checks always pass
+
+
+struct AllocationCounts
+{
+	uint64_t allocations;
+	uint64_t bytes;
+};
+
+inline AllocationCounts& ThreadAllocations()
+{
+	static thread_local AllocationCounts counts = {0, 0};
+	return counts;
+}
+
+
+#ifdef MATSU_ALLOCATION_TRACKING
+
+inline bool AllocationTracking()
+{
+	return true;
+}
+
+inline void* TrackedAllocation(size_t size)
+{
+	AllocationCounts& counts = ThreadAllocations();
+	counts.allocations += 1;
+	counts.bytes += size;
+
+	return malloc((size != 0) ? size : 1);
+}
+
+// clang-format off
+void* operator new(size_t size)
+{
+	void* p = TrackedAllocation(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)                                 { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept   { return TrackedAllocation(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return TrackedAllocation(size); }
+
+void operator delete(void* p) noexcept                          { free(p); }
+void operator delete[](void* p) noexcept                        { free(p); }
+void operator delete(void* p, size_t) noexcept                  { free(p); }
+void operator delete[](void* p, size_t) noexcept                { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept   { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+// clang-format on
+
+#else
+
+inline bool AllocationTracking()
+{
+	return false;
+}
+
+#endif
+
+
+class AllocationScope
+{
+	// Allocations of this thread from construction on. Setup goes before
+	// it, inside what is meant not to allocate
+  public:
+	AllocationScope()
+	{
+		m_start = ThreadAllocations();
+	}
+
+	AllocationCounts Get() const
+	{
+		const AllocationCounts& now = ThreadAllocations();
+		return {now.allocations - m_start.allocations, now.bytes - m_start.bytes};
+	}
+
+	bool Check(const char* what) const
+	{
+		// False if anything allocated, saying so on standard error
+		const AllocationCounts counts = Get();
+		if (counts.allocations == 0)
+			return true;
+
+		fprintf(stderr, "%s: %llu allocations, %llu bytes\n", what, static_cast<unsigned long long>(counts.allocations),
+		        static_cast<unsigned long long>(counts.bytes));
+		return false;
+	}
+
+  private:
+	AllocationCounts m_start;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_BATCH_HPP
+#define MATSU_BATCH_HPP
+
+#include "trace.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Batches of independent jobs (renders, mostly) over all cores. Workers
+// take the next job as they free up. Each has an index, for things that
+// shouldn't be shared (buffers, analysis state) to be one per worker.
+
+
+inline size_t BatchWorkers(size_t requested = 0)
+{
+	// Zero meaning one per core
+	if (requested != 0)
+		return requested;
+
+	const unsigned cores = std::thread::hardware_concurrency();
+	return (cores != 0) ? static_cast<size_t>(cores) : 1;
+}
+
+template <typename F> void BatchRun(size_t jobs, size_t workers, F f)
+{
+	// Calls 'f(job, worker)' once per job, returns when all are done
+	std::atomic<size_t> next(0);
+	const auto worker = [&](size_t index)
+	{
+		for (size_t job = next++; job < jobs; job = next++)
+		{
+			MATSU_TRACE_SCOPE("Job", "batch");
+			f(job, index);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < workers; i += 1)
+		threads.emplace_back(worker, i);
+
+	worker(0); // This thread too
+	for (auto& thread : threads)
+		thread.join();
+}
+
+#endif
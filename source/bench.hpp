@@ -0,0 +1,495 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_BENCH_HPP
+#define MATSU_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dispatch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MATSU_BENCH_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define MATSU_BENCH_TSC
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MATSU_BENCH_PERF
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/utsname.h>
+#endif
+
+#ifdef MATSU_REVISION_HEADER
+#include "matsu-revision.hpp" // Generated at every build
+#endif
+#ifndef MATSU_GIT_REVISION
+#define MATSU_GIT_REVISION "unknown" // Both given by the build
+#endif
+#ifndef MATSU_BUILD_FLAGS
+#define MATSU_BUILD_FLAGS "unknown"
+#endif
+
+// Benchmarks harness. A benchmark being a lambda processing a given number
+// of samples and returning something out of them, so the compiler can't
+// throw the work away. Runs discarded as warmup, then timed repetitions.
+
+
+static volatile double g_bench_sink; // Where results go to not be optimized out
+
+
+inline uint64_t BenchCycles()
+{
+	// Time stamp counter, cycles at the nominal frequency rather than actual
+	// core ones, so turbo and throttling show up. Zero if not around
+#ifdef MATSU_BENCH_TSC
+	return static_cast<uint64_t>(__rdtsc());
+#else
+	return 0;
+#endif
+}
+
+
+struct BenchStats
+{
+	double min;
+	double max;
+	double mean;
+	double median;
+	double stddev; // Sample one
+	double mad;    // Median absolute deviation, robust to the odd interrupted run
+};
+
+inline BenchStats BenchSummary(std::vector<double> v)
+{
+	BenchStats s = {};
+	if (v.size() == 0)
+		return s;
+
+	std::sort(v.begin(), v.end());
+	s.min = v.front();
+	s.max = v.back();
+	s.median = (v.size() % 2 == 1) ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2.0;
+
+	double sum = 0.0;
+	for (const double x : v)
+		sum += x;
+	s.mean = sum / static_cast<double>(v.size());
+
+	double sq = 0.0;
+	for (const double x : v)
+		sq += (x - s.mean) * (x - s.mean);
+	s.stddev = (v.size() > 1) ? sqrt(sq / static_cast<double>(v.size() - 1)) : 0.0;
+
+	std::vector<double> deviations;
+	for (const double x : v)
+		deviations.push_back(fabs(x - s.median));
+	std::sort(deviations.begin(), deviations.end());
+	s.mad = deviations[deviations.size() / 2];
+
+	return s;
+}
+
+
+class BenchCounters
+{
+	// Hardware counters through 'perf_event_open', Linux only. User space
+	// only, as that is what kernel.perf_event_paranoid allows by default.
+	// Counters a machine lacks (virtual ones often) are left out
+  public:
+	static constexpr size_t CYCLES = 0;
+	static constexpr size_t INSTRUCTIONS = 1;
+	static constexpr size_t BRANCH_MISSES = 2;
+	static constexpr size_t CACHE_MISSES = 3;
+	static constexpr size_t NO = 4;
+
+	BenchCounters()
+	{
+		for (size_t i = 0; i < NO; i += 1)
+			m_fd[i] = -1;
+		m_opened = 0;
+
+#ifdef MATSU_BENCH_PERF
+		const uint64_t configs[NO] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		                              PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+		for (size_t i = 0; i < NO; i += 1)
+		{
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configs[i];
+			attr.disabled = (m_opened == 0) ? 1 : 0; // Leader starts the group
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP;
+
+			const int leader = (m_opened == 0) ? -1 : m_fd[m_order[0]];
+			m_fd[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+
+			if (m_fd[i] >= 0)
+			{
+				m_order[m_opened] = i;
+				m_opened += 1;
+			}
+		}
+#endif
+	}
+
+	~BenchCounters()
+	{
+#ifdef MATSU_BENCH_PERF
+		for (size_t i = 0; i < NO; i += 1)
+		{
+			if (m_fd[i] >= 0)
+				close(m_fd[i]);
+		}
+#endif
+	}
+
+	BenchCounters(const BenchCounters&) = delete;
+	BenchCounters& operator=(const BenchCounters&) = delete;
+
+	bool Available(size_t counter) const
+	{
+		return m_fd[counter] >= 0;
+	}
+
+	bool AnyAvailable() const
+	{
+		return m_opened != 0;
+	}
+
+	void Start()
+	{
+#ifdef MATSU_BENCH_PERF
+		if (m_opened == 0)
+			return;
+
+		ioctl(m_fd[m_order[0]], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(m_fd[m_order[0]], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	void Stop(uint64_t out[NO])
+	{
+		for (size_t i = 0; i < NO; i += 1)
+			out[i] = 0;
+
+#ifdef MATSU_BENCH_PERF
+		if (m_opened == 0)
+			return;
+
+		ioctl(m_fd[m_order[0]], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+		// Group format: number of counters, then values in opening order
+		uint64_t values[1 + NO];
+		if (read(m_fd[m_order[0]], values, sizeof(values)) < static_cast<ssize_t>(sizeof(uint64_t)))
+			return;
+
+		for (size_t i = 0; i < std::min(static_cast<size_t>(values[0]), m_opened); i += 1)
+			out[m_order[i]] = values[1 + i];
+#endif
+	}
+
+  private:
+	int m_fd[NO];
+	size_t m_order[NO];
+	size_t m_opened;
+};
+
+
+struct BenchResult
+{
+	const char* name;
+	size_t samples;            // Per repetition
+	double sampling_frequency; // Zero if not audio, otherwise realtime factors make sense
+
+	std::vector<double> ns_per_sample; // One per repetition
+	std::vector<double> cycles_per_sample;
+	BenchStats stats;
+	BenchStats cycles;
+
+	std::vector<double> counters_per_sample[BenchCounters::NO]; // Empty without counters
+	BenchStats counters[BenchCounters::NO];
+
+	double GetRealtimeFactor(double ns_per_sample) const
+	{
+		return 1e9 / (ns_per_sample * sampling_frequency);
+	}
+};
+
+
+class Bench
+{
+  public:
+	Bench(size_t warmup, size_t repetitions, const char* filter, bool counters = false)
+	{
+		m_warmup = warmup;
+		m_repetitions = repetitions;
+		m_filter = filter;
+
+		if (counters == true)
+		{
+			m_counters.reset(new BenchCounters());
+			if (m_counters->AnyAvailable() == false)
+			{
+				fprintf(stderr, "No hardware counters (no permission, or not Linux?), timing only\n");
+				m_counters.reset();
+			}
+		}
+	}
+
+	template <typename LAMBDA>
+	void Run(const char* name, size_t samples, LAMBDA f, double sampling_frequency = 0.0)
+	{
+		if (m_filter != nullptr && strstr(name, m_filter) == nullptr)
+			return;
+
+		for (size_t i = 0; i < m_warmup; i += 1)
+			g_bench_sink = f(samples);
+
+		BenchResult result;
+		result.name = name;
+		result.samples = samples;
+		result.sampling_frequency = sampling_frequency;
+
+		for (size_t i = 0; i < m_repetitions; i += 1)
+		{
+			if (m_counters != nullptr)
+				m_counters->Start();
+
+			const auto start = std::chrono::steady_clock::now();
+			const uint64_t start_cycles = BenchCycles();
+			g_bench_sink = f(samples);
+			const uint64_t end_cycles = BenchCycles();
+			const auto end = std::chrono::steady_clock::now();
+
+			if (m_counters != nullptr)
+			{
+				uint64_t counts[BenchCounters::NO];
+				m_counters->Stop(counts);
+
+				for (size_t c = 0; c < BenchCounters::NO; c += 1)
+				{
+					if (m_counters->Available(c) == true)
+						result.counters_per_sample[c].push_back(static_cast<double>(counts[c]) /
+						                                        static_cast<double>(samples));
+				}
+			}
+
+			const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			result.ns_per_sample.push_back(ns / static_cast<double>(samples));
+			result.cycles_per_sample.push_back(static_cast<double>(end_cycles - start_cycles) /
+			                                   static_cast<double>(samples));
+		}
+
+		result.stats = BenchSummary(result.ns_per_sample);
+		result.cycles = BenchSummary(result.cycles_per_sample);
+		for (size_t c = 0; c < BenchCounters::NO; c += 1)
+			result.counters[c] = BenchSummary(result.counters_per_sample[c]);
+
+		Print(result);
+
+		m_results.push_back(result);
+	}
+
+	const std::vector<BenchResult>& GetResults() const
+	{
+		return m_results;
+	}
+
+	bool WriteJson(const char* filename) const
+	{
+		// What was run, where, and built how. Every repetition goes in, as
+		// comparisons ('matsu-bench-compare') test them for significance
+		FILE* fp = fopen(filename, "w");
+		if (fp == nullptr)
+			return false;
+
+		char host[256] = "unknown";
+		char system[256] = "unknown";
+		char cpu[256] = "unknown";
+#if defined(__unix__) || defined(__APPLE__)
+		utsname u;
+		if (uname(&u) == 0)
+		{
+			snprintf(host, sizeof(host), "%s", u.nodename);
+			snprintf(system, sizeof(system), "%s %s %s", u.sysname, u.release, u.machine);
+		}
+#endif
+#ifdef __linux__
+		if (FILE* info = fopen("/proc/cpuinfo", "r"))
+		{
+			char line[512];
+			while (fgets(line, sizeof(line), info) != nullptr)
+			{
+				const char* colon = strchr(line, ':');
+				if (strncmp(line, "model name", 10) == 0 && colon != nullptr)
+				{
+					snprintf(cpu, sizeof(cpu), "%s", colon + 2);
+					cpu[strcspn(cpu, "\n")] = '\0';
+					break;
+				}
+			}
+			fclose(info);
+		}
+#endif
+
+#if defined(__clang__)
+		const char* compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+		const char* compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+		const char* compiler = "msvc";
+#else
+		const char* compiler = "unknown";
+#endif
+
+		fprintf(fp, "{\n");
+		fprintf(fp, "\t\"host\": \"%s\",\n", JsonEscape(host).c_str());
+		fprintf(fp, "\t\"system\": \"%s\",\n", JsonEscape(system).c_str());
+		fprintf(fp, "\t\"cpu\": \"%s\",\n", JsonEscape(cpu).c_str());
+		fprintf(fp, "\t\"cpu_level\": \"%s\",\n", CpuLevelName(GetCpuLevel())); // Of kernels
+		fprintf(fp, "\t\"threads\": %u,\n", std::thread::hardware_concurrency());
+		fprintf(fp, "\t\"compiler\": \"%s\",\n", JsonEscape(compiler).c_str());
+		fprintf(fp, "\t\"flags\": \"%s\",\n", JsonEscape(MATSU_BUILD_FLAGS).c_str());
+		fprintf(fp, "\t\"revision\": \"%s\",\n", JsonEscape(MATSU_GIT_REVISION).c_str());
+		fprintf(fp, "\t\"warmup\": %zu,\n", m_warmup);
+		fprintf(fp, "\t\"benchmarks\": [");
+
+		for (size_t i = 0; i < m_results.size(); i += 1)
+		{
+			const BenchResult& r = m_results[i];
+			fprintf(fp, "%s\n\t\t{\n", (i == 0) ? "" : ",");
+			fprintf(fp, "\t\t\t\"name\": \"%s\",\n", JsonEscape(r.name).c_str());
+			fprintf(fp, "\t\t\t\"samples\": %zu,\n", r.samples);
+			fprintf(fp, "\t\t\t\"sampling_frequency\": %.0f,\n", r.sampling_frequency);
+			fprintf(fp,
+			        "\t\t\t\"ns_per_sample\": {\"median\": %.6g, \"mean\": %.6g, \"stddev\": %.6g, \"min\": %.6g, "
+			        "\"max\": %.6g, \"mad\": %.6g},\n",
+			        r.stats.median, r.stats.mean, r.stats.stddev, r.stats.min, r.stats.max, r.stats.mad);
+			fprintf(fp, "\t\t\t\"cycles_per_sample\": %.6g,\n", r.cycles.median);
+
+			static const char* COUNTER_NAMES[BenchCounters::NO] = {"core_cycles", "instructions", "branch_misses",
+			                                                        "cache_misses"};
+			for (size_t c = 0; c < BenchCounters::NO; c += 1)
+			{
+				if (r.counters_per_sample[c].size() != 0)
+					fprintf(fp, "\t\t\t\"%s_per_sample\": %.6g,\n", COUNTER_NAMES[c], r.counters[c].median);
+			}
+
+			fprintf(fp, "\t\t\t\"repetitions\": [");
+			for (size_t n = 0; n < r.ns_per_sample.size(); n += 1)
+				fprintf(fp, "%s%.6g", (n == 0) ? "" : ", ", r.ns_per_sample[n]);
+			fprintf(fp, "]\n\t\t}");
+		}
+
+		fprintf(fp, "\n\t]\n}\n");
+		return (fclose(fp) == 0);
+	}
+
+	void PrintHeader() const
+	{
+		printf("%-32s %10s %10s %10s %10s %10s %12s %10s %10s", "Benchmark", "Median", "Mean", "Stddev", "Min", "Mad",
+		       "Samples/s", "Cycles", "Realtime");
+		if (m_counters != nullptr)
+			printf(" %10s %10s %6s %10s %10s", "Core", "Instr.", "IPC", "Branch", "Cache");
+
+		printf("\n%-32s %10s %10s %10s %10s %10s %12s %10s %10s", "", "ns/sample", "", "", "", "", "median",
+		       "/sample", "factor");
+		if (m_counters != nullptr)
+			printf(" %10s %10s %6s %10s %10s", "cycles", "/sample", "", "misses", "misses");
+
+		printf("\n");
+	}
+
+  private:
+	size_t m_warmup;
+	size_t m_repetitions;
+	const char* m_filter;
+
+	std::unique_ptr<BenchCounters> m_counters;
+	std::vector<BenchResult> m_results;
+
+	static std::string JsonEscape(const char* s)
+	{
+		std::string out;
+		for (; *s != '\0'; s += 1)
+		{
+			if (*s == '"' || *s == '\\')
+				out += '\\';
+			if (static_cast<unsigned char>(*s) >= 0x20)
+				out += *s;
+		}
+		return out;
+	}
+
+	void Print(const BenchResult& r) const
+	{
+		char cycles[32] = "-";
+		char realtime[32] = "-";
+
+		if (r.cycles.median > 0.0)
+			snprintf(cycles, sizeof(cycles), "%.2f", r.cycles.median);
+		if (r.sampling_frequency > 0.0)
+			snprintf(realtime, sizeof(realtime), "%.1fx", r.GetRealtimeFactor(r.stats.median));
+
+		printf("%-32s %10.3f %10.3f %10.3f %10.3f %10.3f %12.4g %10s %10s", r.name, r.stats.median, r.stats.mean,
+		       r.stats.stddev, r.stats.min, r.stats.mad, 1e9 / r.stats.median, cycles, realtime);
+
+		if (m_counters != nullptr)
+		{
+			// Medians per sample, '-' where the machine has no such counter
+			char c[BenchCounters::NO][32];
+			for (size_t i = 0; i < BenchCounters::NO; i += 1)
+			{
+				if (m_counters->Available(i) == true)
+					snprintf(c[i], sizeof(c[i]), "%.3f", r.counters[i].median);
+				else
+					snprintf(c[i], sizeof(c[i]), "-");
+			}
+
+			char ipc[32] = "-";
+			if (m_counters->Available(BenchCounters::CYCLES) == true &&
+			    m_counters->Available(BenchCounters::INSTRUCTIONS) == true &&
+			    r.counters[BenchCounters::CYCLES].median > 0.0)
+				snprintf(ipc, sizeof(ipc), "%.2f",
+				         r.counters[BenchCounters::INSTRUCTIONS].median / r.counters[BenchCounters::CYCLES].median);
+
+			printf(" %10s %10s %6s %10s %10s", c[BenchCounters::CYCLES], c[BenchCounters::INSTRUCTIONS], ipc,
+			       c[BenchCounters::BRANCH_MISSES], c[BenchCounters::CACHE_MISSES]);
+		}
+
+		printf("\n");
+	}
+};
+
+#endif
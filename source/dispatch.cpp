@@ -0,0 +1,495 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "dispatch.hpp"
+#include "matsu.hpp"
+
+// Kernels of every level, compiled here once. Levels above Sse2 (the x86-64
+// baseline) through target attributes rather than compiler flags, so that
+// nothing else in the program uses their instructions. Built with
+// '-ffp-contract=off' (see 'CMakeLists.txt'), fused multiply adds, that
+// Avx512 brings along, rounding differently than the scalar kernels
+
+#ifdef MATSU_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define MATSU_AVX2
+#define MATSU_AVX512
+#else
+#include <cpuid.h>
+#define MATSU_AVX2 __attribute__((target("avx2")))
+#define MATSU_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+
+// BS.1770-4 annex 2 filter, rows being taps from oldest sample in window to
+// newest, columns the four phases
+// clang-format off
+alignas(64) static const double TRUE_PEAK[TRUE_PEAK_TAPS][4] = {
+    {-0.0083007812500, -0.0189208984375, -0.0291748046875, 0.0017089843750},
+    {0.0148925781250, 0.0330810546875, 0.0292968750000, 0.0109863281250},
+    {-0.0266113281250, -0.0582275390625, -0.0517578125000, -0.0196533203125},
+    {0.0476074218750, 0.1015625000000, 0.0891113281250, 0.0332031250000},
+    {-0.1022949218750, -0.2003173828125, -0.1665039062500, -0.0594482421875},
+    {0.9721679687500, 0.7797851562500, 0.4650878906250, 0.1373291015625},
+    {0.1373291015625, 0.4650878906250, 0.7797851562500, 0.9721679687500},
+    {-0.0594482421875, -0.1665039062500, -0.2003173828125, -0.1022949218750},
+    {0.0332031250000, 0.0891113281250, 0.1015625000000, 0.0476074218750},
+    {-0.0196533203125, -0.0517578125000, -0.0582275390625, -0.0266113281250},
+    {0.0109863281250, 0.0292968750000, 0.0330810546875, 0.0148925781250},
+    {0.0017089843750, -0.0291748046875, -0.0189208984375, -0.0083007812500},
+};
+// clang-format on
+
+
+// Scalar
+// ------
+
+static double TruePeakScalar(const double* x, size_t windows)
+{
+	double peak = 0.0;
+	for (size_t w = 0; w < windows; w += 1)
+	{
+		double p[4] = {0.0, 0.0, 0.0, 0.0};
+		for (size_t i = 0; i < TRUE_PEAK_TAPS; i += 1)
+		{
+			for (size_t phase = 0; phase < 4; phase += 1)
+				p[phase] += x[w + i] * TRUE_PEAK[i][phase];
+		}
+
+		peak = Max(peak, Max(Max(fabs(p[0]), fabs(p[1])), Max(fabs(p[2]), fabs(p[3]))));
+	}
+
+	return peak;
+}
+
+static double DotScalar(const double* a, const double* b, size_t n)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < n; i += 1)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+static void ToS24Scalar(const double* in, size_t n, uint8_t* out)
+{
+	for (size_t i = 0; i < n; i += 1)
+		out = PutS24(in[i], out);
+}
+
+static void ToS16Scalar(const double* in, size_t n, uint8_t* out)
+{
+	for (size_t i = 0; i < n; i += 1)
+	{
+		const auto v = static_cast<int16_t>(Clamp(in[i], -1.0, 1.0) * 32767.0);
+		memcpy(out + i * sizeof(int16_t), &v, sizeof(int16_t));
+	}
+}
+
+static void ToF32Scalar(const double* in, size_t n, uint8_t* out)
+{
+	for (size_t i = 0; i < n; i += 1)
+	{
+		const auto v = static_cast<float>(in[i]);
+		memcpy(out + i * sizeof(float), &v, sizeof(float));
+	}
+}
+
+
+#ifdef MATSU_SSE2
+
+// Sse2
+// ----
+
+static double TruePeakSse2(const double* x, size_t windows)
+{
+	// A row multiplies one sample, and all phases come out together in two
+	// registers
+	const __m128d sign = _mm_set1_pd(-0.0);
+	__m128d peak = _mm_setzero_pd();
+
+	for (size_t w = 0; w < windows; w += 1)
+	{
+		__m128d p01 = _mm_setzero_pd();
+		__m128d p23 = _mm_setzero_pd();
+
+		for (size_t i = 0; i < TRUE_PEAK_TAPS; i += 1)
+		{
+			const __m128d s = _mm_set1_pd(x[w + i]);
+			p01 = _mm_add_pd(p01, _mm_mul_pd(s, _mm_load_pd(TRUE_PEAK[i] + 0)));
+			p23 = _mm_add_pd(p23, _mm_mul_pd(s, _mm_load_pd(TRUE_PEAK[i] + 2)));
+		}
+
+		peak = _mm_max_pd(peak, _mm_max_pd(_mm_andnot_pd(sign, p01), _mm_andnot_pd(sign, p23)));
+	}
+
+	return Max(_mm_cvtsd_f64(peak), _mm_cvtsd_f64(_mm_unpackhi_pd(peak, peak)));
+}
+
+static double DotSse2(const double* a, const double* b, size_t n)
+{
+	size_t i = 0;
+	__m128d s0 = _mm_setzero_pd();
+	__m128d s1 = _mm_setzero_pd();
+
+	for (; i + 4 <= n; i += 4)
+	{
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+	}
+
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(s0, s1));
+
+	double sum = lanes[0] + lanes[1];
+	for (; i < n; i += 1)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+static void ToS16Sse2(const double* in, size_t n, uint8_t* out)
+{
+	const __m128d low = _mm_set1_pd(-1.0);
+	const __m128d high = _mm_set1_pd(1.0);
+	const __m128d scale = _mm_set1_pd(32767.0);
+
+	const auto convert = [&](const double* x)
+	{
+		return _mm_cvttpd_epi32(_mm_mul_pd(_mm_max_pd(low, _mm_min_pd(_mm_loadu_pd(x), high)), scale));
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m128i a = _mm_unpacklo_epi64(convert(in + i + 0), convert(in + i + 2));
+		const __m128i b = _mm_unpacklo_epi64(convert(in + i + 4), convert(in + i + 6));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(int16_t)), _mm_packs_epi32(a, b));
+	}
+
+	ToS16Scalar(in + i, n - i, out + i * sizeof(int16_t));
+}
+
+static void ToF32Sse2(const double* in, size_t n, uint8_t* out)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m128 v = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in + i)), _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2)));
+		_mm_storeu_ps(reinterpret_cast<float*>(out + i * sizeof(float)), v);
+	}
+
+	ToF32Scalar(in + i, n - i, out + i * sizeof(float));
+}
+
+
+// Avx2
+// ----
+
+MATSU_AVX2 static double TruePeakAvx2(const double* x, size_t windows)
+{
+	// Four windows at once, one to a lane, each phase in a register of its
+	// own. Per lane same operations in the same order as the scalar kernel
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	__m256d peak = _mm256_setzero_pd();
+
+	size_t w = 0;
+	for (; w + 4 <= windows; w += 4)
+	{
+		__m256d p[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+		for (size_t i = 0; i < TRUE_PEAK_TAPS; i += 1)
+		{
+			const __m256d s = _mm256_loadu_pd(x + w + i);
+			for (size_t phase = 0; phase < 4; phase += 1)
+				p[phase] = _mm256_add_pd(p[phase], _mm256_mul_pd(s, _mm256_set1_pd(TRUE_PEAK[i][phase])));
+		}
+
+		for (size_t phase = 0; phase < 4; phase += 1)
+			peak = _mm256_max_pd(peak, _mm256_andnot_pd(sign, p[phase]));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, peak);
+	return Max(Max(Max(lanes[0], lanes[1]), Max(lanes[2], lanes[3])), TruePeakScalar(x + w, windows - w));
+}
+
+MATSU_AVX2 static double DotAvx2(const double* a, const double* b, size_t n)
+{
+	size_t i = 0;
+	__m256d s0 = _mm256_setzero_pd();
+	__m256d s1 = _mm256_setzero_pd();
+
+	for (; i + 8 <= n; i += 8)
+	{
+		s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+		s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+
+	double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	for (; i < n; i += 1)
+		sum += a[i] * b[i];
+
+	return sum;
+}
+
+MATSU_AVX2 static void ToS24Avx2(const double* in, size_t n, uint8_t* out)
+{
+	// Four samples to twelve bytes, stored as sixteen, the last four then
+	// overwritten by the next store. So vectors stop two samples short of
+	// the end, for those four bytes to be there
+	const __m256d scale_a = _mm256_set1_pd(127.0);
+	const __m256d scale_b = _mm256_set1_pd(8388607.0);
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	size_t i = 0;
+	for (; i + 6 <= n; i += 4)
+	{
+		const __m256d x = _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(in + i), scale_a), scale_b);
+		const __m128i v = _mm_srli_epi32(_mm256_cvttpd_epi32(x), 7);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 3), _mm_shuffle_epi8(v, pack));
+	}
+
+	ToS24Scalar(in + i, n - i, out + i * 3);
+}
+
+MATSU_AVX2 static void ToS16Avx2(const double* in, size_t n, uint8_t* out)
+{
+	const __m256d low = _mm256_set1_pd(-1.0);
+	const __m256d high = _mm256_set1_pd(1.0);
+	const __m256d scale = _mm256_set1_pd(32767.0);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m256d a = _mm256_max_pd(low, _mm256_min_pd(_mm256_loadu_pd(in + i), high));
+		const __m256d b = _mm256_max_pd(low, _mm256_min_pd(_mm256_loadu_pd(in + i + 4), high));
+		const __m128i v = _mm_packs_epi32(_mm256_cvttpd_epi32(_mm256_mul_pd(a, scale)),
+		                                  _mm256_cvttpd_epi32(_mm256_mul_pd(b, scale)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(int16_t)), v);
+	}
+
+	ToS16Scalar(in + i, n - i, out + i * sizeof(int16_t));
+}
+
+MATSU_AVX2 static void ToF32Avx2(const double* in, size_t n, uint8_t* out)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(reinterpret_cast<float*>(out + i * sizeof(float)), _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+
+	ToF32Scalar(in + i, n - i, out + i * sizeof(float));
+}
+
+
+// Avx512
+// ------
+
+MATSU_AVX512 static double TruePeakAvx512(const double* x, size_t windows)
+{
+	// As the Avx2 kernel, eight windows at once
+	__m512d peak = _mm512_setzero_pd();
+
+	size_t w = 0;
+	for (; w + 8 <= windows; w += 8)
+	{
+		__m512d p[4] = {_mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd()};
+		for (size_t i = 0; i < TRUE_PEAK_TAPS; i += 1)
+		{
+			const __m512d s = _mm512_loadu_pd(x + w + i);
+			for (size_t phase = 0; phase < 4; phase += 1)
+				p[phase] = _mm512_add_pd(p[phase], _mm512_mul_pd(s, _mm512_set1_pd(TRUE_PEAK[i][phase])));
+		}
+
+		for (size_t phase = 0; phase < 4; phase += 1)
+			peak = _mm512_max_pd(peak, _mm512_abs_pd(p[phase]));
+	}
+
+	return Max(_mm512_reduce_max_pd(peak), TruePeakAvx2(x + w, windows - w));
+}
+
+MATSU_AVX512 static double DotAvx512(const double* a, const double* b, size_t n)
+{
+	size_t i = 0;
+	__m512d s0 = _mm512_setzero_pd();
+	__m512d s1 = _mm512_setzero_pd();
+
+	for (; i + 16 <= n; i += 16)
+	{
+		s0 = _mm512_add_pd(s0, _mm512_mul_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+		s1 = _mm512_add_pd(s1, _mm512_mul_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8)));
+	}
+
+	return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1)) + DotAvx2(a + i, b + i, n - i);
+}
+
+
+// Detection
+// ---------
+
+static void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t out[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int r[4];
+	__cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (size_t i = 0; i < 4; i += 1)
+		out[i] = static_cast<uint32_t>(r[i]);
+#else
+	unsigned r[4];
+	if (__get_cpuid_count(leaf, subleaf, &r[0], &r[1], &r[2], &r[3]) == 0)
+		r[0] = r[1] = r[2] = r[3] = 0;
+	for (size_t i = 0; i < 4; i += 1)
+		out[i] = r[i];
+#endif
+}
+
+static uint64_t Xgetbv()
+{
+	// Register state the operating system saves, without which wider
+	// registers can't be used even if the processor has them
+#if defined(_MSC_VER) && !defined(__clang__)
+	return _xgetbv(0);
+#else
+	uint32_t eax;
+	uint32_t edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+#endif
+
+
+static CpuLevel Detect()
+{
+#ifdef MATSU_SSE2
+	uint32_t r1[4];
+	Cpuid(1, 0, r1);
+	const bool osxsave = ((r1[2] >> 27) & 1) != 0;
+	const bool avx = ((r1[2] >> 28) & 1) != 0;
+	if (osxsave == false || avx == false)
+		return CpuLevel::Sse2;
+
+	const uint64_t xcr0 = Xgetbv();
+	if ((xcr0 & 0x06) != 0x06) // Sse and Avx state
+		return CpuLevel::Sse2;
+
+	uint32_t r7[4];
+	Cpuid(7, 0, r7);
+	const bool avx2 = ((r7[1] >> 5) & 1) != 0;
+	const bool avx512f = ((r7[1] >> 16) & 1) != 0;
+	if (avx2 == false)
+		return CpuLevel::Sse2;
+
+	if (avx512f == true && (xcr0 & 0xE0) == 0xE0) // Plus opmask and upper Zmm state
+		return CpuLevel::Avx512;
+
+	return CpuLevel::Avx2;
+#else
+	return CpuLevel::Scalar;
+#endif
+}
+
+static CpuLevel Select()
+{
+	const CpuLevel detected = CpuDetect();
+	const char* forced = getenv("MATSU_CPU");
+	if (forced == nullptr || forced[0] == '\0')
+		return detected;
+
+	for (int l = 0; l <= static_cast<int>(CpuLevel::Avx512); l += 1)
+	{
+		const auto level = static_cast<CpuLevel>(l);
+		if (strcmp(forced, CpuLevelName(level)) != 0)
+			continue;
+
+		if (level > detected)
+		{
+			fprintf(stderr, "MATSU_CPU: '%s' not supported here, using '%s'\n", forced, CpuLevelName(detected));
+			return detected;
+		}
+
+		return level;
+	}
+
+	fprintf(stderr, "MATSU_CPU: unknown level '%s', using '%s'\n", forced, CpuLevelName(detected));
+	return detected;
+}
+
+
+static const Kernels KERNELS_SCALAR = {
+    CpuLevel::Scalar, TruePeakScalar, DotScalar, ToS24Scalar, ToS16Scalar, ToF32Scalar};
+#ifdef MATSU_SSE2
+static const Kernels KERNELS_SSE2 = {
+    CpuLevel::Sse2, TruePeakSse2, DotSse2, ToS24Scalar, ToS16Sse2, ToF32Sse2}; // No byte shuffles for s24
+static const Kernels KERNELS_AVX2 = {
+    CpuLevel::Avx2, TruePeakAvx2, DotAvx2, ToS24Avx2, ToS16Avx2, ToF32Avx2};
+static const Kernels KERNELS_AVX512 = {
+    CpuLevel::Avx512, TruePeakAvx512, DotAvx512, ToS24Avx2, ToS16Avx2, ToF32Avx2};
+#endif
+
+const char* CpuLevelName(CpuLevel level)
+{
+	switch (level)
+	{
+	case CpuLevel::Scalar: return "scalar";
+	case CpuLevel::Sse2: return "sse2";
+	case CpuLevel::Avx2: return "avx2";
+	case CpuLevel::Avx512: return "avx512";
+	}
+
+	return "unknown";
+}
+
+CpuLevel CpuDetect()
+{
+	static const CpuLevel level = Detect();
+	return level;
+}
+
+CpuLevel GetCpuLevel()
+{
+	static const CpuLevel level = Select();
+	return level;
+}
+
+const Kernels& GetKernels()
+{
+	static const Kernels* kernels = KernelsOf(GetCpuLevel());
+	return *kernels;
+}
+
+const Kernels* KernelsOf(CpuLevel level)
+{
+	if (level > CpuDetect())
+		return nullptr;
+
+	switch (level)
+	{
+	case CpuLevel::Scalar: return &KERNELS_SCALAR;
+#ifdef MATSU_SSE2
+	case CpuLevel::Sse2: return &KERNELS_SSE2;
+	case CpuLevel::Avx2: return &KERNELS_AVX2;
+	case CpuLevel::Avx512: return &KERNELS_AVX512;
+#else
+	default: break;
+#endif
+	}
+
+	return nullptr;
+}
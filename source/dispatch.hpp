@@ -0,0 +1,66 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_DISPATCH_HPP
+#define MATSU_DISPATCH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernels over blocks of samples compiled for several instruction set
+// levels, the best one the processor (and operating system) supports
+// chosen at first use. Environment variable 'MATSU_CPU' (scalar, sse2,
+// avx2, avx512) forces a lower one, to test or compare them. Definitions
+// in 'dispatch.cpp', part of the 'matsu_core' library
+
+// True peak and conversion kernels give the same results at every level,
+// bit for bit. The dot product doesn't, sums being taken in another order
+
+
+static constexpr size_t TRUE_PEAK_TAPS = 12; // Per phase, of the 4x oversampling filter of BS.1770-4
+
+enum class CpuLevel
+{
+	Scalar,
+	Sse2,
+	Avx2,
+	Avx512
+};
+
+struct Kernels
+{
+	CpuLevel level;
+
+	// Largest absolute value oversampled, over 'windows' windows of
+	// 'TRUE_PEAK_TAPS' samples (oldest first). The first one starting at
+	// 'x', the next ones a sample later each
+	double (*true_peak)(const double* x, size_t windows);
+
+	double (*dot)(const double* a, const double* b, size_t n);
+
+	// As 'PutS24()', to 16 bits clamped to [-1, 1], and to float. What
+	// 'Stream' writes, 'out' of 'n' times 3, 2 or 4 bytes
+	void (*to_s24)(const double* in, size_t n, uint8_t* out);
+	void (*to_s16)(const double* in, size_t n, uint8_t* out);
+	void (*to_f32)(const double* in, size_t n, uint8_t* out);
+};
+
+const char* CpuLevelName(CpuLevel level);
+CpuLevel CpuDetect(); // What the processor supports, ignoring 'MATSU_CPU'
+
+CpuLevel GetCpuLevel();      // In use
+const Kernels& GetKernels(); // Of the level in use
+
+const Kernels* KernelsOf(CpuLevel level); // Null if not supported, or not compiled in
+
+#endif
@@ -0,0 +1,220 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_DUAL_HPP
+#define MATSU_DUAL_HPP
+
+#include "matsu.hpp"
+
+// Forward mode automatic differentiation. A value along with its partial
+// derivatives with respect to 'N' inputs, carried through every operation
+// by the chain rule. As sample type of primitives and renders, these give
+// per sample how the output changes with each parameter.
+// Comparisons (thus branches, 'Min()', 'Max()', 'Clamp()') go by value,
+// derivatives there being those of the branch taken.
+
+
+template <size_t N> class Dual
+{
+  public:
+	double value;
+	double d[N];
+
+	Dual(double v = 0.0) // Constants, no derivatives
+	{
+		value = v;
+		for (size_t i = 0; i < N; i += 1)
+			d[i] = 0.0;
+	}
+
+	static Dual Variable(double v, size_t i, double scale = 1.0)
+	{
+		// Input 'i', derivative 'scale' for those with respect to something
+		// else ('v' being a scaled version of it)
+		Dual x(v);
+		x.d[i] = scale;
+		return x;
+	}
+
+	Dual& operator+=(const Dual& b)
+	{
+		value += b.value;
+		for (size_t i = 0; i < N; i += 1)
+			d[i] += b.d[i];
+		return *this;
+	}
+
+	Dual& operator-=(const Dual& b)
+	{
+		value -= b.value;
+		for (size_t i = 0; i < N; i += 1)
+			d[i] -= b.d[i];
+		return *this;
+	}
+
+	Dual& operator*=(const Dual& b)
+	{
+		for (size_t i = 0; i < N; i += 1)
+			d[i] = d[i] * b.value + value * b.d[i];
+		value *= b.value;
+		return *this;
+	}
+
+	Dual& operator/=(const Dual& b)
+	{
+		const double r = 1.0 / b.value;
+		for (size_t i = 0; i < N; i += 1)
+			d[i] = (d[i] - value * r * b.d[i]) * r;
+		value *= r;
+		return *this;
+	}
+};
+
+
+template <size_t N> Dual<N> Chain(const Dual<N>& x, double value, double derivative)
+{
+	// 'f(x)' given 'f(x.value)' and 'f'(x.value)'
+	Dual<N> y(value);
+	for (size_t i = 0; i < N; i += 1)
+		y.d[i] = derivative * x.d[i];
+	return y;
+}
+
+// clang-format off
+template <size_t N> Dual<N> operator+(Dual<N> a, const Dual<N>& b) { return a += b; }
+template <size_t N> Dual<N> operator-(Dual<N> a, const Dual<N>& b) { return a -= b; }
+template <size_t N> Dual<N> operator*(Dual<N> a, const Dual<N>& b) { return a *= b; }
+template <size_t N> Dual<N> operator/(Dual<N> a, const Dual<N>& b) { return a /= b; }
+
+template <size_t N> Dual<N> operator+(Dual<N> a, double b) { a.value += b; return a; }
+template <size_t N> Dual<N> operator+(double a, Dual<N> b) { b.value += a; return b; }
+template <size_t N> Dual<N> operator-(Dual<N> a, double b) { a.value -= b; return a; }
+template <size_t N> Dual<N> operator-(double a, const Dual<N>& b) { return Chain(b, a - b.value, -1.0); }
+template <size_t N> Dual<N> operator*(const Dual<N>& a, double b) { return Chain(a, a.value * b, b); }
+template <size_t N> Dual<N> operator*(double a, const Dual<N>& b) { return Chain(b, a * b.value, a); }
+template <size_t N> Dual<N> operator/(const Dual<N>& a, double b) { return Chain(a, a.value / b, 1.0 / b); }
+template <size_t N> Dual<N> operator/(double a, const Dual<N>& b) { return Dual<N>(a) /= b; }
+template <size_t N> Dual<N> operator-(const Dual<N>& a)             { return Chain(a, -a.value, -1.0); }
+
+#define MATSU_DUAL_COMPARISON(op) \
+	template <size_t N> bool operator op(const Dual<N>& a, const Dual<N>& b) { return a.value op b.value; } \
+	template <size_t N> bool operator op(const Dual<N>& a, double b)         { return a.value op b; } \
+	template <size_t N> bool operator op(double a, const Dual<N>& b)         { return a op b.value; }
+
+MATSU_DUAL_COMPARISON(<)
+MATSU_DUAL_COMPARISON(>)
+MATSU_DUAL_COMPARISON(<=)
+MATSU_DUAL_COMPARISON(>=)
+MATSU_DUAL_COMPARISON(==)
+MATSU_DUAL_COMPARISON(!=)
+
+#undef MATSU_DUAL_COMPARISON
+// clang-format on
+
+
+// Math, found by argument dependent lookup from templated code
+
+template <size_t N> double Value(const Dual<N>& x)
+{
+	return x.value;
+}
+
+template <size_t N> Dual<N> Quantized(const Dual<N>& exact, double quantized)
+{
+	// Derivatives of the exact value, as if quantization didn't happen
+	Dual<N> y = exact;
+	y.value = quantized;
+	return y;
+}
+
+template <size_t N> Dual<N> exp(const Dual<N>& x)
+{
+	const double e = exp(x.value);
+	return Chain(x, e, e);
+}
+
+template <size_t N> Dual<N> log(const Dual<N>& x)
+{
+	return Chain(x, log(x.value), 1.0 / x.value);
+}
+
+template <size_t N> Dual<N> sqrt(const Dual<N>& x)
+{
+	const double s = sqrt(x.value);
+	return Chain(x, s, (s != 0.0) ? 0.5 / s : 0.0);
+}
+
+template <size_t N> Dual<N> sin(const Dual<N>& x)
+{
+	return Chain(x, sin(x.value), cos(x.value));
+}
+
+template <size_t N> Dual<N> cos(const Dual<N>& x)
+{
+	return Chain(x, cos(x.value), -sin(x.value));
+}
+
+template <size_t N> Dual<N> fabs(const Dual<N>& x)
+{
+	return Chain(x, fabs(x.value), (x.value < 0.0) ? -1.0 : 1.0);
+}
+
+template <size_t N> Dual<N> fmod(const Dual<N>& x, double y)
+{
+	// Wrapping phases, it doesn't change how they move
+	return Chain(x, fmod(x.value, y), 1.0);
+}
+
+template <size_t N> Dual<N> pow(const Dual<N>& x, double y)
+{
+	const double p = pow(x.value, y);
+	return Chain(x, p, (x.value != 0.0) ? y * p / x.value : 0.0);
+}
+
+template <size_t N> Dual<N> pow(const Dual<N>& x, const Dual<N>& y)
+{
+	// x^y = e^(y * ln(x)), at zero (envelopes start there) derivatives
+	// taken as zero, rather than infinite or not a number
+	const double p = pow(x.value, y.value);
+	if (x.value <= 0.0)
+		return Dual<N>(p);
+
+	const double dx = y.value * p / x.value;
+	const double dy = p * log(x.value);
+
+	Dual<N> r(p);
+	for (size_t i = 0; i < N; i += 1)
+		r.d[i] = dx * x.d[i] + dy * y.d[i];
+	return r;
+}
+
+// Approximate kernels, values approximate, derivatives exact
+
+template <size_t N> Dual<N> FastSin(const Dual<N>& x)
+{
+	return Chain(x, FastSin(x.value), cos(x.value));
+}
+
+template <size_t N> Dual<N> FastExp(const Dual<N>& x)
+{
+	const double e = FastExp(x.value);
+	return Chain(x, e, e);
+}
+
+template <size_t N> Dual<N> LutExp(const Dual<N>& x)
+{
+	const double e = LutExp(x.value);
+	return Chain(x, e, e);
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_KIT_HPP
+#define MATSU_KIT_HPP
+
+#include "matsu.hpp"
+
+// Single file kit, samples of all voices contiguous and page aligned, after
+// an index of fixed size entries. A player can map the whole file and use
+// samples in place. Everything little endian.
+
+static constexpr uint32_t KIT_VERSION = 1;
+static constexpr uint32_t KIT_PAGE_SIZE = 4096; // Largest common, pages of 16k still allowed by 'page_size'
+
+enum class KitFormat : uint32_t
+{
+	F32 = 1,
+	S16 = 2
+};
+
+struct KitHeader
+{
+	char magic[8]; // "MATSUKIT", no terminator
+	uint32_t version;
+	uint32_t voices_no;
+	uint32_t page_size;
+	uint32_t reserved;
+};
+
+struct KitEntry
+{
+	char name[32]; // Terminated
+	uint32_t sampling_frequency;
+	uint32_t format; // KitFormat
+	uint64_t offset; // In bytes, from file start
+	uint64_t length; // In samples
+};
+
+static_assert(sizeof(KitHeader) == 24, "");
+static_assert(sizeof(KitEntry) == 56, "");
+
+
+struct KitVoice
+{
+	const char* name;
+	const double* samples;
+	size_t length;
+	double sampling_frequency;
+};
+
+
+inline size_t KitSampleSize(KitFormat format)
+{
+	return (format == KitFormat::F32) ? sizeof(float) : sizeof(int16_t);
+}
+
+inline uint64_t KitAlign(uint64_t offset, uint64_t page_size)
+{
+	return ((offset + page_size - 1) / page_size) * page_size;
+}
+
+inline int ExportKit(const KitVoice* voices, size_t voices_no, KitFormat format, const char* filename)
+{
+	FILE* fp = fopen(filename, "wb");
+	if (fp == nullptr)
+		return 1;
+
+	// Header and index
+	KitHeader header = {};
+	memcpy(header.magic, "MATSUKIT", 8);
+	header.version = KIT_VERSION;
+	header.voices_no = static_cast<uint32_t>(voices_no);
+	header.page_size = KIT_PAGE_SIZE;
+
+	std::vector<KitEntry> entries(voices_no);
+	uint64_t offset = KitAlign(sizeof(KitHeader) + sizeof(KitEntry) * voices_no, KIT_PAGE_SIZE);
+
+	for (size_t i = 0; i < voices_no; i += 1)
+	{
+		memset(&entries[i], 0, sizeof(KitEntry));
+		strncpy(entries[i].name, voices[i].name, sizeof(KitEntry::name) - 1);
+		entries[i].sampling_frequency = static_cast<uint32_t>(voices[i].sampling_frequency);
+		entries[i].format = static_cast<uint32_t>(format);
+		entries[i].offset = offset;
+		entries[i].length = static_cast<uint64_t>(voices[i].length);
+
+		offset = KitAlign(offset + KitSampleSize(format) * voices[i].length, KIT_PAGE_SIZE);
+	}
+
+	fwrite(&header, sizeof(KitHeader), 1, fp);
+	fwrite(entries.data(), sizeof(KitEntry), voices_no, fp);
+
+	// Samples, converted in blocks, padded with silence up to next page
+	uint8_t block[KIT_PAGE_SIZE];
+	uint64_t position = sizeof(KitHeader) + sizeof(KitEntry) * voices_no;
+
+	for (size_t i = 0; i < voices_no; i += 1)
+	{
+		memset(block, 0, KIT_PAGE_SIZE);
+		fwrite(block, 1, static_cast<size_t>(entries[i].offset - position), fp);
+		position = entries[i].offset;
+
+		const size_t block_length = KIT_PAGE_SIZE / KitSampleSize(format);
+		for (size_t x = 0; x < voices[i].length; x += block_length)
+		{
+			const size_t length = Min(block_length, voices[i].length - x);
+			const double* in = voices[i].samples + x;
+
+			if (format == KitFormat::F32)
+			{
+				for (size_t s = 0; s < length; s += 1)
+				{
+					const auto v = static_cast<float>(in[s]);
+					memcpy(block + s * sizeof(float), &v, sizeof(float));
+				}
+			}
+			else
+			{
+				for (size_t s = 0; s < length; s += 1)
+				{
+					const auto v = static_cast<int16_t>(Clamp(in[s], -1.0, 1.0) * 32767.0);
+					memcpy(block + s * sizeof(int16_t), &v, sizeof(int16_t));
+				}
+			}
+
+			fwrite(block, 1, length * KitSampleSize(format), fp);
+			position += length * KitSampleSize(format);
+		}
+	}
+
+	// Last page
+	memset(block, 0, KIT_PAGE_SIZE);
+	fwrite(block, 1, static_cast<size_t>(KitAlign(position, KIT_PAGE_SIZE) - position), fp);
+
+	const bool failure = (ferror(fp) != 0);
+	fclose(fp);
+
+	return (failure == true) ? 1 : 0;
+}
+
+
+// Player side, 'kit' being the mapped file, no copies and no parsing besides validation.
+// Assumes a little endian host, as is the file
+
+inline bool KitEntryValid(const KitHeader* header, const KitEntry* entry, size_t size)
+{
+	// Samples page aligned (pages a power of two, no smaller than a sample),
+	// after the index and inside the file, name terminated
+	const auto format = static_cast<KitFormat>(entry->format);
+	if (format != KitFormat::F32 && format != KitFormat::S16)
+		return false;
+
+	const uint32_t page_size = header->page_size;
+	if (page_size < KitSampleSize(format) || (page_size & (page_size - 1)) != 0)
+		return false;
+
+	if (entry->offset % page_size != 0 || entry->offset > size ||
+	    entry->offset < sizeof(KitHeader) + sizeof(KitEntry) * header->voices_no)
+		return false;
+
+	if (entry->length > (size - entry->offset) / KitSampleSize(format)) // Not multiplied, it could overflow
+		return false;
+
+	return memchr(entry->name, '\0', sizeof(KitEntry::name)) != nullptr;
+}
+
+inline const KitEntry* KitEntries(const void* kit, size_t size)
+{
+	// Header, index and every entry validated, null if anything is off
+	if (size < sizeof(KitHeader))
+		return nullptr;
+
+	const auto header = static_cast<const KitHeader*>(kit);
+	if (memcmp(header->magic, "MATSUKIT", 8) != 0 || header->version != KIT_VERSION)
+		return nullptr;
+
+	if (size < sizeof(KitHeader) + sizeof(KitEntry) * header->voices_no)
+		return nullptr;
+
+	const auto entries = reinterpret_cast<const KitEntry*>(header + 1);
+	for (uint32_t i = 0; i < header->voices_no; i += 1)
+	{
+		if (KitEntryValid(header, entries + i, size) == false)
+			return nullptr;
+	}
+
+	return entries;
+}
+
+inline const void* KitSamples(const void* kit, size_t size, const KitEntry* entry)
+{
+	// 'kit' and 'size' as for 'KitEntries()', null if the entry doesn't
+	// pass the same checks
+	if (KitEntryValid(static_cast<const KitHeader*>(kit), entry, size) == false)
+		return nullptr;
+
+	return static_cast<const uint8_t*>(kit) + entry->offset;
+}
+
+#endif
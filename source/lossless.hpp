@@ -0,0 +1,352 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_LOSSLESS_HPP
+#define MATSU_LOSSLESS_HPP
+
+#include "matsu.hpp"
+
+// Lossless s24 codec for our samples. Blocks of independent fixed
+// polynomial predictors (as Flac's), residuals zigzag mapped then bit
+// packed in groups of 128 with a width each. Decaying samples get narrow
+// groups as they fade, and unpacking is just shifts and masks, four lanes
+// at a time (SIMD-BP128 layout):
+// https://arxiv.org/abs/1209.2137
+
+// File: header, then blocks each starting with its size in bytes.
+// Block: order (byte), 3 reserved, 'order' warmup samples (int32), one
+// width per group (bytes), groups. Everything little endian.
+
+static constexpr uint32_t LOSSLESS_BLOCK_LENGTH = 4096;
+static constexpr uint32_t LOSSLESS_GROUP_LENGTH = 128;
+static constexpr uint32_t LOSSLESS_MAX_ORDER = 3;
+
+struct LosslessHeader
+{
+	char magic[4]; // "MTL1"
+	uint32_t sampling_frequency;
+	uint32_t length;
+	uint32_t block_length;
+};
+
+static_assert(sizeof(LosslessHeader) == 16, "");
+
+
+inline int32_t LosslessPrediction(const int32_t* x, uint32_t order)
+{
+	// From previous samples, 'x[-1]' being the last one
+	// clang-format off
+	switch (order)
+	{
+	case 1: return x[-1];
+	case 2: return 2 * x[-1] - x[-2];
+	case 3: return 3 * x[-1] - 3 * x[-2] + x[-3];
+	}
+	// clang-format on
+
+	return 0;
+}
+
+inline uint32_t LosslessZigzag(int32_t r)
+{
+	return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(-static_cast<int32_t>(r < 0));
+}
+
+inline uint32_t LosslessWidth(uint32_t v)
+{
+	uint32_t width = 0;
+	for (; v != 0; v >>= 1)
+		width += 1;
+	return width;
+}
+
+
+inline void LosslessPack(const uint32_t* v, uint32_t width, uint8_t* out)
+{
+	// Lane 'l' holds values l, l + 4, l + 8... packed in its own 32 bits
+	// words, and words of the four lanes interleave
+	for (uint32_t l = 0; l < 4; l += 1)
+	{
+		uint64_t acc = 0;
+		uint32_t bits = 0;
+		uint32_t word = 0;
+
+		for (uint32_t i = 0; i < LOSSLESS_GROUP_LENGTH / 4; i += 1)
+		{
+			acc |= static_cast<uint64_t>(v[l + i * 4]) << bits;
+			bits += width;
+
+			if (bits >= 32)
+			{
+				const auto w = static_cast<uint32_t>(acc);
+				memcpy(out + (word * 4 + l) * sizeof(uint32_t), &w, sizeof(uint32_t));
+
+				word += 1;
+				acc >>= 32;
+				bits -= 32;
+			}
+		}
+	}
+}
+
+inline void LosslessUnpack(const uint8_t* in, uint32_t width, int32_t* out)
+{
+	// Unpacks and undoes zigzag, so out come residuals
+	if (width == 0)
+	{
+		memset(out, 0, sizeof(int32_t) * LOSSLESS_GROUP_LENGTH);
+		return;
+	}
+
+	const uint32_t mask = (width == 32) ? 0xFFFFFFFF : ((1u << width) - 1);
+
+#ifdef MATSU_SSE2
+	const __m128i m = _mm_set1_epi32(static_cast<int32_t>(mask));
+	const __m128i one = _mm_set1_epi32(1);
+
+	uint32_t words_left = width - 1;
+	uint32_t shift = 0;
+	__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+
+	for (uint32_t i = 0; i < LOSSLESS_GROUP_LENGTH / 4; i += 1)
+	{
+		__m128i v = _mm_srl_epi32(w, _mm_cvtsi32_si128(static_cast<int>(shift)));
+		shift += width;
+
+		if (shift >= 32 && words_left > 0)
+		{
+			in += 16;
+			words_left -= 1;
+			w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+
+			shift -= 32;
+			if (shift > 0)
+				v = _mm_or_si128(v, _mm_sll_epi32(w, _mm_cvtsi32_si128(static_cast<int>(width - shift))));
+		}
+
+		v = _mm_and_si128(v, m);
+		v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), v);
+	}
+#else
+	for (uint32_t l = 0; l < 4; l += 1)
+	{
+		uint64_t acc = 0;
+		uint32_t bits = 0;
+		uint32_t word = 0;
+
+		for (uint32_t i = 0; i < LOSSLESS_GROUP_LENGTH / 4; i += 1)
+		{
+			if (bits < width)
+			{
+				uint32_t w;
+				memcpy(&w, in + (word * 4 + l) * sizeof(uint32_t), sizeof(uint32_t));
+				acc |= static_cast<uint64_t>(w) << bits;
+				bits += 32;
+				word += 1;
+			}
+
+			const auto v = static_cast<uint32_t>(acc) & mask;
+			acc >>= width;
+			bits -= width;
+
+			out[l + i * 4] = static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+		}
+	}
+#endif
+}
+
+
+inline std::vector<uint8_t> LosslessEncode(const int32_t* samples, size_t length, double sampling_frequency)
+{
+	std::vector<uint8_t> out(sizeof(LosslessHeader));
+	{
+		LosslessHeader header;
+		memcpy(header.magic, "MTL1", 4);
+		header.sampling_frequency = static_cast<uint32_t>(sampling_frequency);
+		header.length = static_cast<uint32_t>(length);
+		header.block_length = LOSSLESS_BLOCK_LENGTH;
+		memcpy(out.data(), &header, sizeof(LosslessHeader));
+	}
+
+	uint32_t residuals[LOSSLESS_BLOCK_LENGTH + LOSSLESS_GROUP_LENGTH];
+
+	for (size_t b = 0; b < length; b += LOSSLESS_BLOCK_LENGTH)
+	{
+		const int32_t* x = samples + b;
+		const auto block_length = static_cast<uint32_t>(Min(length - b, static_cast<size_t>(LOSSLESS_BLOCK_LENGTH)));
+
+		// Predictor with smallest residuals
+		uint32_t order = 0;
+		{
+			uint64_t best = UINT64_MAX;
+			for (uint32_t o = 0; o <= Min(LOSSLESS_MAX_ORDER, block_length); o += 1)
+			{
+				uint64_t sum = 0;
+				for (uint32_t i = o; i < block_length; i += 1)
+					sum += LosslessZigzag(x[i] - LosslessPrediction(x + i, o));
+
+				if (sum < best)
+				{
+					best = sum;
+					order = o;
+				}
+			}
+		}
+
+		const uint32_t residuals_no = block_length - order;
+		const uint32_t groups_no = (residuals_no + LOSSLESS_GROUP_LENGTH - 1) / LOSSLESS_GROUP_LENGTH;
+
+		for (uint32_t i = 0; i < groups_no * LOSSLESS_GROUP_LENGTH; i += 1)
+		{
+			const uint32_t s = order + i;
+			residuals[i] = (i < residuals_no) ? LosslessZigzag(x[s] - LosslessPrediction(x + s, order)) : 0;
+		}
+
+		// Write it
+		const size_t start = out.size();
+		out.resize(start + sizeof(uint32_t) + 4 + sizeof(int32_t) * order + groups_no);
+
+		uint8_t* block = out.data() + start + sizeof(uint32_t);
+		block[0] = static_cast<uint8_t>(order);
+		block[1] = block[2] = block[3] = 0;
+		memcpy(block + 4, x, sizeof(int32_t) * order);
+
+		for (uint32_t g = 0; g < groups_no; g += 1)
+		{
+			uint32_t max = 0;
+			for (uint32_t i = 0; i < LOSSLESS_GROUP_LENGTH; i += 1)
+				max |= residuals[g * LOSSLESS_GROUP_LENGTH + i];
+
+			const uint32_t width = LosslessWidth(max);
+			out[start + sizeof(uint32_t) + 4 + sizeof(int32_t) * order + g] = static_cast<uint8_t>(width);
+
+			const size_t group_start = out.size();
+			out.resize(group_start + width * 16);
+			LosslessPack(residuals + g * LOSSLESS_GROUP_LENGTH, width, out.data() + group_start);
+		}
+
+		const auto block_size = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+		memcpy(out.data() + start, &block_size, sizeof(uint32_t));
+	}
+
+	return out;
+}
+
+
+inline size_t LosslessMinimumSize(size_t length)
+{
+	// Smallest a payload of 'length' samples encodes to: every block with
+	// order zero and groups all of width zero (its size, order and widths)
+	const size_t full = length / LOSSLESS_BLOCK_LENGTH;
+	const size_t rest = length % LOSSLESS_BLOCK_LENGTH;
+	const auto block = [](size_t block_length)
+	{
+		return sizeof(uint32_t) + 4 + (block_length + LOSSLESS_GROUP_LENGTH - 1) / LOSSLESS_GROUP_LENGTH;
+	};
+
+	return full * block(LOSSLESS_BLOCK_LENGTH) + ((rest != 0) ? block(rest) : 0);
+}
+
+
+inline bool LosslessDecode(const uint8_t* data, size_t size, std::vector<int32_t>* out, double* sampling_frequency)
+{
+	LosslessHeader header;
+	if (size < sizeof(LosslessHeader))
+		return false;
+
+	memcpy(&header, data, sizeof(LosslessHeader));
+	if (memcmp(header.magic, "MTL1", 4) != 0 || header.block_length != LOSSLESS_BLOCK_LENGTH)
+		return false;
+
+	// Length as the file says, so bounded by what the rest of it could hold
+	// before allocating for it
+	if (LosslessMinimumSize(header.length) > size - sizeof(LosslessHeader))
+		return false;
+
+	*sampling_frequency = static_cast<double>(header.sampling_frequency);
+	out->resize(header.length + LOSSLESS_GROUP_LENGTH); // Room for last group to unpack whole
+
+	const uint8_t* end = data + size;
+	data += sizeof(LosslessHeader);
+
+	for (size_t b = 0; b < header.length; b += LOSSLESS_BLOCK_LENGTH)
+	{
+		uint32_t block_size;
+		if (end - data < static_cast<ptrdiff_t>(sizeof(uint32_t) + 4))
+			return false;
+
+		memcpy(&block_size, data, sizeof(uint32_t));
+		data += sizeof(uint32_t);
+
+		if (block_size < 4 || end - data < static_cast<ptrdiff_t>(block_size))
+			return false;
+
+		const uint8_t* block = data;
+		data += block_size;
+
+		const auto block_length =
+		    static_cast<uint32_t>(Min(header.length - b, static_cast<size_t>(LOSSLESS_BLOCK_LENGTH)));
+		const uint32_t order = block[0];
+		if (order > LOSSLESS_MAX_ORDER || order > block_length)
+			return false;
+
+		const uint32_t groups_no = (block_length - order + LOSSLESS_GROUP_LENGTH - 1) / LOSSLESS_GROUP_LENGTH;
+		const uint8_t* widths = block + 4 + sizeof(int32_t) * order;
+		const uint8_t* groups = widths + groups_no;
+
+		// Validate sizes before touching anything, widths included
+		{
+			size_t expected = 4 + sizeof(int32_t) * order + groups_no;
+			if (expected > block_size)
+				return false;
+
+			for (uint32_t g = 0; g < groups_no; g += 1)
+			{
+				if (widths[g] > 32)
+					return false;
+				expected += widths[g] * 16;
+			}
+
+			if (expected != block_size)
+				return false;
+		}
+
+		// Residuals
+		int32_t* x = out->data() + b;
+		memcpy(x, block + 4, sizeof(int32_t) * order);
+
+		for (uint32_t g = 0; g < groups_no; g += 1)
+		{
+			LosslessUnpack(groups, widths[g], x + order + g * LOSSLESS_GROUP_LENGTH);
+			groups += widths[g] * 16;
+		}
+
+		// Predict, serial by nature. As unsigned, wrapping around, so that
+		// corrupt residuals can't overflow
+		auto u = reinterpret_cast<uint32_t*>(x);
+		// clang-format off
+		switch (order)
+		{
+		case 1: for (uint32_t i = 1; i < block_length; i += 1) u[i] += u[i - 1]; break;
+		case 2: for (uint32_t i = 2; i < block_length; i += 1) u[i] += 2 * u[i - 1] - u[i - 2]; break;
+		case 3: for (uint32_t i = 3; i < block_length; i += 1) u[i] += 3 * u[i - 1] - 3 * u[i - 2] + u[i - 3]; break;
+		}
+		// clang-format on
+	}
+
+	out->resize(header.length);
+	return true;
+}
+
+#endif
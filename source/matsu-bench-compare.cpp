@@ -0,0 +1,343 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "bench.hpp"
+
+#include <map>
+#include <stdlib.h>
+#include <string>
+
+// Usage: matsu-bench-compare baseline.json current.json [--threshold percent] [--alpha p] [--allow-gone]
+// Compares results written by 'matsu-bench --json' or '606-bench --json'.
+// A benchmark regresses when its median time grows beyond the threshold
+// (5% by default) and a Mann-Whitney U test on repetitions says it isn't
+// chance (p below 0.01 by default). Exits with 1 if anything regressed,
+// or if a benchmark of the baseline is gone (unless '--allow-gone')
+
+
+struct JsonValue
+{
+	// Enough Json for our own files, no unicode escapes
+	enum class Type
+	{
+		Null,
+		Boolean,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type type = Type::Null;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+
+	const JsonValue* Get(const char* key) const
+	{
+		const auto i = object.find(key);
+		return (i != object.end()) ? &i->second : nullptr;
+	}
+};
+
+static bool JsonParse(const char** c, JsonValue* out);
+
+static void JsonSkip(const char** c)
+{
+	while (**c == ' ' || **c == '\t' || **c == '\n' || **c == '\r')
+		*c += 1;
+}
+
+static bool JsonParseString(const char** c, std::string* out)
+{
+	if (**c != '"')
+		return false;
+
+	for (*c += 1; **c != '"'; *c += 1)
+	{
+		if (**c == '\0')
+			return false;
+		if (**c == '\\')
+		{
+			*c += 1; // Escaped, may not be the end
+			if (**c == '\0')
+				return false;
+		}
+		*out += **c;
+	}
+
+	*c += 1;
+	return true;
+}
+
+static bool JsonParse(const char** c, JsonValue* out)
+{
+	JsonSkip(c);
+
+	if (**c == '{')
+	{
+		out->type = JsonValue::Type::Object;
+		for (*c += 1, JsonSkip(c); **c != '}'; JsonSkip(c))
+		{
+			std::string key;
+			JsonSkip(c);
+			if (JsonParseString(c, &key) == false)
+				return false;
+
+			JsonSkip(c);
+			if (**c != ':')
+				return false;
+			*c += 1;
+
+			if (JsonParse(c, &out->object[key]) == false)
+				return false;
+
+			JsonSkip(c);
+			if (**c == ',')
+				*c += 1;
+			else if (**c != '}')
+				return false;
+		}
+		*c += 1;
+	}
+	else if (**c == '[')
+	{
+		out->type = JsonValue::Type::Array;
+		for (*c += 1, JsonSkip(c); **c != ']'; JsonSkip(c))
+		{
+			out->array.emplace_back();
+			if (JsonParse(c, &out->array.back()) == false)
+				return false;
+
+			JsonSkip(c);
+			if (**c == ',')
+				*c += 1;
+			else if (**c != ']')
+				return false;
+		}
+		*c += 1;
+	}
+	else if (**c == '"')
+	{
+		out->type = JsonValue::Type::String;
+		return JsonParseString(c, &out->string);
+	}
+	else if (strncmp(*c, "true", 4) == 0 || strncmp(*c, "false", 5) == 0)
+	{
+		out->type = JsonValue::Type::Boolean;
+		out->number = (**c == 't') ? 1.0 : 0.0;
+		*c += (**c == 't') ? 4 : 5;
+	}
+	else if (strncmp(*c, "null", 4) == 0)
+	{
+		*c += 4;
+	}
+	else
+	{
+		char* end;
+		out->type = JsonValue::Type::Number;
+		out->number = strtod(*c, &end);
+		if (end == *c)
+			return false;
+		*c = end;
+	}
+
+	return true;
+}
+
+static bool JsonLoad(const char* filename, JsonValue* out)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == nullptr)
+		return false;
+
+	std::string text;
+	char buffer[4096];
+	for (size_t read; (read = fread(buffer, 1, sizeof(buffer), fp)) != 0;)
+		text.append(buffer, read);
+	fclose(fp);
+
+	const char* c = text.c_str();
+	return JsonParse(&c, out) == true && out->type == JsonValue::Type::Object;
+}
+
+
+static double MannWhitney(const std::vector<double>& a, const std::vector<double>& b)
+{
+	// Two sided p-value, normal approximation with ties corrected. Doesn't
+	// assume timings are normal, which they rarely are
+	const double n1 = static_cast<double>(a.size());
+	const double n2 = static_cast<double>(b.size());
+	if (a.size() < 2 || b.size() < 2)
+		return 1.0;
+
+	std::vector<std::pair<double, int>> all;
+	for (const double x : a)
+		all.push_back({x, 0});
+	for (const double x : b)
+		all.push_back({x, 1});
+	std::sort(all.begin(), all.end());
+
+	double rank_sum_a = 0.0;
+	double ties = 0.0;
+	for (size_t i = 0; i < all.size();)
+	{
+		size_t j = i;
+		while (j < all.size() && all[j].first == all[i].first)
+			j += 1;
+
+		const double rank = (static_cast<double>(i + j) + 1.0) / 2.0; // Average, ranks from 1
+		for (size_t k = i; k < j; k += 1)
+			rank_sum_a += (all[k].second == 0) ? rank : 0.0;
+
+		const double t = static_cast<double>(j - i);
+		ties += t * t * t - t;
+		i = j;
+	}
+
+	const double n = n1 + n2;
+	const double u = rank_sum_a - n1 * (n1 + 1.0) / 2.0;
+	const double mean = n1 * n2 / 2.0;
+	const double variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+	if (variance <= 0.0)
+		return 1.0;
+
+	const double z = (fabs(u - mean) - 0.5) / sqrt(variance); // Continuity corrected
+	return std::min(erfc(std::max(z, 0.0) / sqrt(2.0)), 1.0);
+}
+
+
+static std::vector<double> Repetitions(const JsonValue& benchmark)
+{
+	std::vector<double> r;
+	if (const JsonValue* v = benchmark.Get("repetitions"))
+	{
+		for (const JsonValue& x : v->array)
+			r.push_back(x.number);
+	}
+	return r;
+}
+
+
+int main(int argc, const char* argv[])
+{
+	const char* filenames[2] = {nullptr, nullptr};
+	double threshold = 5.0;
+	double alpha = 0.01;
+	bool allow_gone = false;
+	int files = 0;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc)
+			alpha = atof(argv[++i]);
+		else if (strcmp(argv[i], "--allow-gone") == 0)
+			allow_gone = true;
+		else if (files < 2)
+			filenames[files++] = argv[i];
+	}
+
+	if (files != 2)
+	{
+		fprintf(stderr, "Usage: matsu-bench-compare baseline.json current.json [--threshold percent] [--alpha p]\n"
+		                "                           [--allow-gone]\n");
+		return 1;
+	}
+
+	JsonValue results[2];
+	for (int f = 0; f < 2; f += 1)
+	{
+		if (JsonLoad(filenames[f], &results[f]) == false)
+		{
+			fprintf(stderr, "Error reading '%s'\n", filenames[f]);
+			return 1;
+		}
+	}
+
+	// Different machines or builds, numbers still compared but be warned
+	for (const char* key : {"cpu", "cpu_level", "compiler", "flags", "revision"})
+	{
+		const JsonValue* a = results[0].Get(key);
+		const JsonValue* b = results[1].Get(key);
+		const char* sa = (a != nullptr) ? a->string.c_str() : "?";
+		const char* sb = (b != nullptr) ? b->string.c_str() : "?";
+
+		if (strcmp(sa, sb) != 0)
+			printf("%-9s '%s' -> '%s'\n", key, sa, sb);
+		else
+			printf("%-9s '%s'\n", key, sa);
+	}
+
+	std::map<std::string, const JsonValue*> baseline;
+	if (const JsonValue* b = results[0].Get("benchmarks"))
+	{
+		for (const JsonValue& x : b->array)
+		{
+			if (const JsonValue* name = x.Get("name"))
+				baseline[name->string] = &x;
+		}
+	}
+
+	printf("\n%-32s %12s %12s %9s %10s\n", "Benchmark", "Baseline", "Current", "Change", "p");
+	printf("%-32s %12s %12s %9s %10s\n", "", "ns/sample", "ns/sample", "", "");
+
+	int regressions = 0;
+	const JsonValue* current = results[1].Get("benchmarks");
+
+	for (const JsonValue& x : (current != nullptr) ? current->array : std::vector<JsonValue>())
+	{
+		const JsonValue* name = x.Get("name");
+		if (name == nullptr)
+			continue;
+
+		const auto b = baseline.find(name->string);
+		if (b == baseline.end())
+		{
+			printf("%-32s %12s\n", name->string.c_str(), "new");
+			continue;
+		}
+
+		const std::vector<double> ra = Repetitions(*b->second);
+		const std::vector<double> rb = Repetitions(x);
+		baseline.erase(b);
+
+		const double ma = BenchSummary(ra).median;
+		const double mb = BenchSummary(rb).median;
+		const double change = (ma > 0.0) ? (mb / ma - 1.0) * 100.0 : 0.0;
+		const double p = MannWhitney(ra, rb);
+
+		const char* verdict = "";
+		if (p < alpha && change > threshold)
+		{
+			verdict = "  REGRESSION";
+			regressions += 1;
+		}
+		else if (p < alpha && change < -threshold)
+			verdict = "  faster";
+
+		printf("%-32s %12.3f %12.3f %+8.1f%% %10.2g%s\n", name->string.c_str(), ma, mb, change, p, verdict);
+	}
+
+	// Removed or renamed, unnoticed otherwise
+	for (const auto& b : baseline)
+		printf("%-32s %12s%s\n", b.first.c_str(), "gone", (allow_gone == true) ? "" : "  FAILURE");
+
+	printf("\n%i regression%s beyond %g%% (p < %g)\n", regressions, (regressions == 1) ? "" : "s", threshold, alpha);
+	if (baseline.size() != 0 && allow_gone == false)
+		printf("%zu benchmark%s gone\n", baseline.size(), (baseline.size() == 1) ? "" : "s");
+
+	return (regressions == 0 && (baseline.size() == 0 || allow_gone == true)) ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#include "bench.hpp"
+#include "matsu.hpp"
+#include "perceptual.hpp"
+
+// Usage: matsu-bench [--warmup n] [--repetitions n] [--counters] [--json file] [filter]
+// Every primitive, alone, over blocks of samples
+// With '--counters' also hardware counters per sample, Linux only. With
+// '--json' results, along with host and build, go to a file as well
+
+
+static constexpr size_t SAMPLES = 65536;
+static constexpr double SAMPLING_FREQUENCY = 44100.0;
+
+int main(int argc, const char* argv[])
+{
+	size_t warmup = 5;
+	size_t repetitions = 31;
+	const char* filter = nullptr;
+	bool counters = false;
+	const char* json = nullptr;
+
+	for (int i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmup = static_cast<size_t>(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+			repetitions = static_cast<size_t>(Max(atoi(argv[++i]), 1));
+		else if (strcmp(argv[i], "--counters") == 0)
+			counters = true;
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+			json = argv[++i];
+		else
+			filter = argv[i];
+	}
+
+	// Inputs, noise so branches can't be predicted away
+	RenderBuffer input(SAMPLES);
+	RenderBuffer output(SAMPLES);
+	std::vector<uint8_t> bytes(SAMPLES * sizeof(double));
+	{
+		auto noise = NoiseGenerator(123);
+		for (size_t i = 0; i < SAMPLES; i += 1)
+			input.GetData()[i] = noise.Step();
+	}
+
+	const double* in = input.GetData();
+	double* out = output.GetData();
+
+	auto bench = Bench(warmup, repetitions, filter, counters);
+	bench.PrintHeader();
+
+	// Generators
+	bench.Run("Oscillator", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto o = Oscillator(120.0, 60.0, 0.1, 0.0, 300.0, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = o.Step([](double x) { return x; });
+		          return out[samples - 1];
+	          });
+
+	bench.Run("Oscillator, eased sweep", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto o = Oscillator(120.0, 60.0, 0.1, 0.0, 300.0, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = o.Step([](double x) { return 1.0 - ExponentialEasing(1.0 - x, 8.0); });
+		          return out[samples - 1];
+	          });
+
+	bench.Run("SquareOscillator", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto o = SquareOscillator(619.0, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = o.Step();
+		          return out[samples - 1];
+	          });
+
+	bench.Run("NoiseGenerator", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto n = NoiseGenerator(1);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = n.Step();
+		          return out[samples - 1];
+	          });
+
+	// Filters
+	bench.Run("OnePoleFilter, lowpass", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto f = OnePoleFilter<FilterType::Lowpass>(7800.0, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = f.Step(in[i]);
+		          return out[samples - 1];
+	          });
+
+	bench.Run("OnePoleFilter, highpass", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto f = OnePoleFilter<FilterType::Highpass>(7800.0, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = f.Step(in[i]);
+		          return out[samples - 1];
+	          });
+
+	bench.Run("TwoPolesFilter, lowpass", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto f = TwoPolesFilter<FilterType::Lowpass>(6600.0, 0.6, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = f.Step(in[i]);
+		          return out[samples - 1];
+	          });
+
+	bench.Run("TwoPolesFilter, highpass", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto f = TwoPolesFilter<FilterType::Highpass>(6600.0, 0.5, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = f.Step(in[i]);
+		          return out[samples - 1];
+	          });
+
+	// Shapes
+	bench.Run("AdEnvelope", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto e = AdEnvelope(2.0, 1500.0, SAMPLING_FREQUENCY);
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = e.Get(
+			              static_cast<int>(i),        //
+			              [](double x) { return x; }, //
+			              [](double x) { return ExponentialEasing(x, 8.0); });
+		          return out[samples - 1];
+	          });
+
+	bench.Run("ExponentialEasing", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = ExponentialEasing(in[i], 8.0);
+		          return out[samples - 1];
+	          });
+
+	bench.Run("Distortion", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          for (size_t i = 0; i < samples; i += 1)
+			          out[i] = Distortion(in[i], -8.0, 0.3);
+		          return out[samples - 1];
+	          });
+
+	// Export
+	bench.Run("Export, s24 conversion", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          uint8_t* o = bytes.data();
+		          for (size_t i = 0; i < samples; i += 1)
+			          o = PutS24(in[i], o);
+		          return static_cast<double>(bytes[samples - 1]);
+	          });
+
+	bench.Run("Export, peak envelope", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto peaks = PeakEnvelope(samples);
+		          for (size_t i = 0; i < samples; i += 1)
+			          peaks.Step(in[i]);
+		          return static_cast<double>(peaks.Metadata().data.unknown.dataSizeInBytes);
+	          });
+
+	bench.Run("Export, loudness meter", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          auto meter = LoudnessMeter(SAMPLING_FREQUENCY, samples);
+		          for (size_t i = 0; i < samples; i += 1)
+			          meter.Step(in[i]);
+		          return meter.GetTruePeak();
+	          });
+
+	// Kernels, at every level this processor has
+	char kernel_names[4][5][48]; // Outliving benchmarks
+	for (int l = 0; l <= static_cast<int>(CpuLevel::Avx512); l += 1)
+	{
+		const Kernels* kernels = KernelsOf(static_cast<CpuLevel>(l));
+		if (kernels == nullptr)
+			continue;
+
+		char(*names)[48] = kernel_names[l];
+		const char* level = CpuLevelName(kernels->level);
+		snprintf(names[0], 48, "Kernel, true peak, %s", level);
+		snprintf(names[1], 48, "Kernel, dot, %s", level);
+		snprintf(names[2], 48, "Kernel, s24 conversion, %s", level);
+		snprintf(names[3], 48, "Kernel, s16 conversion, %s", level);
+		snprintf(names[4], 48, "Kernel, f32 conversion, %s", level);
+
+		bench.Run(names[0], SAMPLES,
+		          [&](size_t samples) { return kernels->true_peak(in, samples - (TRUE_PEAK_TAPS - 1)); });
+		bench.Run(names[1], SAMPLES, [&](size_t samples) { return kernels->dot(in, in, samples); });
+		bench.Run(names[2], SAMPLES,
+		          [&](size_t samples)
+		          {
+			          kernels->to_s24(in, samples, bytes.data());
+			          return static_cast<double>(bytes[samples - 1]);
+		          });
+		bench.Run(names[3], SAMPLES,
+		          [&](size_t samples)
+		          {
+			          kernels->to_s16(in, samples, bytes.data());
+			          return static_cast<double>(bytes[samples - 1]);
+		          });
+		bench.Run(names[4], SAMPLES,
+		          [&](size_t samples)
+		          {
+			          kernels->to_f32(in, samples, bytes.data());
+			          return static_cast<double>(bytes[samples - 1]);
+		          });
+	}
+
+	// Analysis
+	auto analysis = PerceptualAnalysis(SAMPLING_FREQUENCY);
+	PerceptualFeatures features[2];
+	analysis.Analyse(in, SAMPLES, &features[1]);
+
+	bench.Run("PerceptualAnalysis", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          analysis.Analyse(in, samples, &features[0]);
+		          return features[0].onset[0];
+	          });
+
+	bench.Run("PerceptualDistance", SAMPLES,
+	          [&](size_t samples)
+	          {
+		          analysis.Analyse(in, samples, &features[0]);
+		          return PerceptualDistance(features[0], features[1]);
+	          });
+
+	if (json != nullptr && bench.WriteJson(json) == false)
+	{
+		fprintf(stderr, "Error writing '%s'\n", json);
+		return 1;
+	}
+
+	return 0;
+}
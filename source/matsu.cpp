@@ -0,0 +1,247 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wimplicit-int-conversion"
+#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+
+#define DR_WAV_IMPLEMENTATION
+#include "thirdparty/dr_libs/dr_wav.h"
+#pragma clang diagnostic pop
+
+#else
+#define DR_WAV_IMPLEMENTATION
+#include "thirdparty/dr_libs/dr_wav.h"
+#endif
+
+#include "matsu.hpp"
+#include "trace.hpp"
+
+// What of 'matsu.hpp' isn't inline: the dr_wav implementation, and export
+// and import through it. Compiled once, as the 'matsu_core' library
+
+
+static size_t WavFileWrite(void* file, const void* data, size_t size)
+{
+	MATSU_TRACE_SCOPE("Write", "export");
+	return fwrite(data, 1, size, static_cast<FILE*>(file));
+}
+
+static drwav_bool32 WavFileSeek(void* file, int offset, drwav_seek_origin origin)
+{
+	return fseek(static_cast<FILE*>(file), offset, (origin == drwav_seek_origin_start) ? SEEK_SET : SEEK_CUR) == 0;
+}
+
+
+void WriteLoudnessReport(const LoudnessMeter& meter, double sampling_frequency, size_t length, const char* filename)
+{
+	// As 'filename.json'. Silence, with infinite values, as null
+	MATSU_TRACE_SCOPE("Report", "export");
+	char report_filename[256];
+	snprintf(report_filename, sizeof(report_filename), "%s.json", filename);
+
+	FILE* fp = fopen(report_filename, "w");
+	if (fp == nullptr)
+		return;
+
+	const auto value = [](double v, char* buffer, size_t size) -> const char*
+	{
+		if (isfinite(v))
+			snprintf(buffer, size, "%.3f", v);
+		else
+			snprintf(buffer, size, "null");
+		return buffer;
+	};
+
+	char b[4][32];
+	fprintf(fp,
+	        "{\n"
+	        "\t\"file\": \"%s\",\n"
+	        "\t\"sampling_frequency\": %.0f,\n"
+	        "\t\"length\": %zu,\n"
+	        "\t\"sample_peak_dbfs\": %s,\n"
+	        "\t\"true_peak_dbtp\": %s,\n"
+	        "\t\"rms_dbfs\": %s,\n"
+	        "\t\"integrated_lufs\": %s\n"
+	        "}\n",
+	        filename, sampling_frequency, length, value(meter.GetSamplePeak(), b[0], 32),
+	        value(meter.GetTruePeak(), b[1], 32), value(meter.GetRms(), b[2], 32),
+	        value(meter.GetIntegratedLoudness(), b[3], 32));
+
+	fclose(fp);
+}
+
+
+void EncodeWav(const drwav_data_format* format, const void* data, size_t length, PeakEnvelope* peaks,
+               const char* filename)
+{
+	// Own file callbacks, as dr_wav only writes metadata (our peaks) through them.
+	// Peaks are optional
+	MATSU_TRACE_SCOPE("Encode", "export");
+	FILE* fp = fopen(filename, "wb");
+	if (fp == nullptr)
+		return;
+
+	drwav_metadata metadata = {};
+	if (peaks != nullptr)
+		metadata = peaks->Metadata();
+
+	drwav wav;
+	if (drwav_init_write_with_metadata(&wav, format, WavFileWrite, WavFileSeek, fp, nullptr,
+	                                   (peaks != nullptr) ? &metadata : nullptr, //
+	                                   (peaks != nullptr) ? 1 : 0) == DRWAV_TRUE)
+	{
+		drwav_write_pcm_frames(&wav, static_cast<drwav_uint64>(length), data);
+		drwav_uninit(&wav);
+	}
+
+	fclose(fp);
+}
+
+
+static constexpr size_t EXPORT_BLOCK_LENGTH = 512; // In samples, 4 KiB of input
+
+void ExportS24(const double* input, double sampling_frequency, size_t length, const char* filename)
+{
+	auto export_buffer = reinterpret_cast<uint8_t*>(malloc(sizeof(uint8_t) * 3 * length));
+	if (export_buffer == nullptr)
+		return;
+
+	auto peaks = PeakEnvelope(length);
+	auto meter = LoudnessMeter(sampling_frequency, length);
+
+	// Convert to s24 (kernel of 'dispatch.hpp'), with peaks and loudness of
+	// each block computed right after, while it is still in cache. A single
+	// read of the audio
+	{
+		MATSU_TRACE_SCOPE("Convert", "export");
+		const Kernels& kernels = GetKernels();
+
+		for (size_t start = 0; start < length; start += EXPORT_BLOCK_LENGTH)
+		{
+			const size_t block_length = Min(EXPORT_BLOCK_LENGTH, length - start);
+			const double* block = input + start;
+
+			kernels.to_s24(block, block_length, export_buffer + start * 3);
+			for (size_t i = 0; i < block_length; i += 1)
+			{
+				peaks.Step(block[i]);
+				meter.Step(block[i]);
+			}
+		}
+	}
+
+	// Encode
+	{
+		drwav_data_format format;
+		format.container = drwav_container_riff;
+		format.format = DR_WAVE_FORMAT_PCM;
+		format.channels = 1;
+		format.sampleRate = static_cast<drwav_uint32>(sampling_frequency);
+		format.bitsPerSample = 24;
+
+		EncodeWav(&format, export_buffer, length, &peaks, filename);
+		WriteLoudnessReport(meter, sampling_frequency, length, filename);
+	}
+
+	// Bye!
+	free(export_buffer);
+}
+
+
+void ExportF64(const double* input, double sampling_frequency, size_t length, const char* filename)
+{
+	// No conversion here, the analysis pass is the only one
+	auto peaks = PeakEnvelope(length);
+	auto meter = LoudnessMeter(sampling_frequency, length);
+	for (const double* in = input; in < (input + length); in += 1)
+	{
+		peaks.Step(*in);
+		meter.Step(*in);
+	}
+
+	drwav_data_format format;
+	format.container = drwav_container_riff;
+	format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+	format.channels = 1;
+	format.sampleRate = static_cast<drwav_uint32>(sampling_frequency);
+	format.bitsPerSample = 64;
+
+	EncodeWav(&format, input, length, &peaks, filename);
+	WriteLoudnessReport(meter, sampling_frequency, length, filename);
+}
+
+
+bool ImportWav(const char* filename, RenderBuffer* out, double* sampling_frequency)
+{
+	// Any format dr_wav decodes, channels mixed down to one. Our f64 exports
+	// come back exact, integer ones scaled to [-1, 1) as read
+	drwav wav;
+	if (drwav_init_file(&wav, filename, nullptr) == DRWAV_FALSE)
+		return false;
+
+	const auto frames = static_cast<size_t>(wav.totalPCMFrameCount);
+	const size_t channels = wav.channels;
+
+	RenderBuffer interleaved(frames * channels);
+	if (interleaved.GetLength() != frames * channels || out->Resize(frames) == false)
+	{
+		drwav_uninit(&wav);
+		return false;
+	}
+
+	size_t read = 0;
+	double* data = interleaved.GetData();
+
+	if (wav.translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT && wav.bitsPerSample == 64)
+	{
+		read = static_cast<size_t>(drwav_read_pcm_frames(&wav, frames, data));
+	}
+	else if (wav.translatedFormatTag == DR_WAVE_FORMAT_PCM)
+	{
+		// Decoded in place, int32 taking half the room of double. Backwards so
+		// conversion never steps over what is still to convert
+		auto s32 = reinterpret_cast<drwav_int32*>(data);
+		read = static_cast<size_t>(drwav_read_pcm_frames_s32(&wav, frames, s32));
+
+		for (size_t i = read * channels; i > 0; i -= 1)
+			data[i - 1] = static_cast<double>(s32[i - 1]) / 2147483648.0;
+	}
+	else
+	{
+		auto f32 = reinterpret_cast<float*>(data);
+		read = static_cast<size_t>(drwav_read_pcm_frames_f32(&wav, frames, f32));
+
+		for (size_t i = read * channels; i > 0; i -= 1)
+			data[i - 1] = static_cast<double>(f32[i - 1]);
+	}
+
+	*sampling_frequency = static_cast<double>(wav.sampleRate);
+	drwav_uninit(&wav);
+
+	// Mix down
+	double* o = out->GetData();
+	for (size_t i = 0; i < read; i += 1)
+	{
+		double sum = 0.0;
+		for (size_t c = 0; c < channels; c += 1)
+			sum += data[i * channels + c];
+
+		o[i] = sum / static_cast<double>(channels);
+	}
+
+	return (read == frames);
+}
@@ -15,23 +15,15 @@ defined by the Mozilla Public License, v. 2.0.
 
 #include <math.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wold-style-cast"
-#pragma clang diagnostic ignored "-Wsign-conversion"
-#pragma clang diagnostic ignored "-Wimplicit-int-conversion"
-#pragma clang diagnostic ignored "-Wimplicit-int-float-conversion"
+#include "dispatch.hpp"
 
-#define DR_WAV_IMPLEMENTATION
+// Declarations only, implementation in 'matsu.cpp'
 #include "thirdparty/dr_libs/dr_wav.h"
-#pragma clang diagnostic pop
-
-#else
-#define DR_WAV_IMPLEMENTATION
-#include "thirdparty/dr_libs/dr_wav.h"
-#endif
 
 
 #ifndef M_PI
@@ -40,6 +32,11 @@ defined by the Mozilla Public License, v. 2.0.
 
 #define M_PI_TWO 6.283185307179586476925
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATSU_SSE2
+#include <emmintrin.h>
+#endif
+
 
 // clang-format off
 template <typename T> T Max(T a, T b)            { return (a > b) ? a : b; }
@@ -50,6 +47,23 @@ template <typename T> T Clamp(T v, T min, T max) { return Max(min, Min(v, max));
 // clang-format on
 
 
+// Primitives are templates of their sample type, double unless asked for
+// another one ('Dual' of 'dual.hpp', to carry derivatives). Which then
+// overloads these two
+
+inline double Value(double x)
+{
+	return x;
+}
+
+inline double Quantized(double, double quantized)
+{
+	// A quantization of 'exact' (a duration to whole samples, say), for
+	// derivatives to still see the exact value
+	return quantized;
+}
+
+
 inline int MillisecondsToSamples(double milliseconds, double sampling_frequency)
 {
 	return static_cast<int>((milliseconds * sampling_frequency) / 1000.0);
@@ -80,13 +94,97 @@ inline uint64_t Random(uint64_t* state)
 	return x * static_cast<uint64_t>(0x2545F4914F6CDD1D);
 }
 
-inline double ExponentialEasing(double x, double a)
+
+// Approximate kernels, off by default. A mask given as template parameter
+// ('K') to the primitives using them, and to renders, so exact ones carry
+// no check. Every combination can be measured against them ('606-approx')
+
+static constexpr unsigned KERNEL_FAST_SIN = 1 << 0; // In Oscillator
+static constexpr unsigned KERNEL_FAST_EXP = 1 << 1; // In ExponentialEasing
+static constexpr unsigned KERNEL_LUT_EXP = 1 << 2;  // In Distortion
+static constexpr unsigned KERNELS_NO = 3;
+
+inline double FastSin(double x)
+{
+	// Reduced to [-pi, pi], folded into [-pi/2, pi/2], Taylor up to the
+	// 11th power. Error below 6e-8
+	x -= M_PI_TWO * floor(x / M_PI_TWO + 0.5);
+	if (x > M_PI / 2.0)
+		x = M_PI - x;
+	else if (x < -M_PI / 2.0)
+		x = -M_PI - x;
+
+	const double x2 = x * x;
+	return x * (1.0 + x2 * (-1.0 / 6.0 + x2 * (1.0 / 120.0 + x2 * (-1.0 / 5040.0 + //
+	                                                               x2 * (1.0 / 362880.0 + x2 * (-1.0 / 39916800.0))))));
+}
+
+inline double FastExp(double x)
+{
+	// As 2^n * e^r, 'r' in [-ln(2)/2, ln(2)/2] by Taylor up to the 5th
+	// power. Relative error below 3e-6
+	x = Clamp(x, -708.0, 709.0);
+	const double n = floor(x * 1.4426950408889634 + 0.5);
+	const double r = x - n * 0.6931471805599453;
+	const double p = 1.0 + r * (1.0 + r * (1.0 / 2.0 + r * (1.0 / 6.0 + r * (1.0 / 24.0 + r * (1.0 / 120.0)))));
+
+	const uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(n) + 1023) << 52;
+	double scale;
+	memcpy(&scale, &bits, sizeof(double));
+	return p * scale;
+}
+
+inline double LutExp(double x)
+{
+	// Linear interpolation of 32 points per unit, over [-32, 32]. Relative
+	// error below 1.3e-4, outside the table exact
+	static constexpr double MIN = -32.0;
+	static constexpr double RESOLUTION = 32.0;
+	static constexpr size_t SIZE = 64 * 32 + 1;
+
+	struct Table
+	{
+		double v[SIZE];
+		Table()
+		{
+			for (size_t i = 0; i < SIZE; i += 1)
+				v[i] = exp(MIN + static_cast<double>(i) / RESOLUTION);
+		}
+	};
+	static const Table table;
+
+	const double i = (x - MIN) * RESOLUTION;
+	if (i < 0.0 || i >= static_cast<double>(SIZE - 1))
+		return exp(x);
+
+	const auto integer = static_cast<size_t>(i);
+	return Mix(table.v[integer], table.v[integer + 1], i - static_cast<double>(integer));
+}
+
+
+template <typename T, unsigned K = 0> T ExponentialEasing(T x, T a)
 {
+	if ((K & KERNEL_FAST_EXP) != 0)
+		return ((FastExp(a * fabs(x)) - 1.0) / (FastExp(a) - 1.0)) * Sign(x);
+
 	return ((exp(a * fabs(x)) - 1.0) / (exp(a) - 1.0)) * Sign(x);
 }
 
-inline double Distortion(double x, double d, double asymmetry)
+// Under it negative halves overflow ('d' up to 12), or zero divides
+static constexpr double DISTORTION_ASYMMETRY_MIN = 1.0 / 32.0;
+
+template <typename T, unsigned K = 0> T Distortion(T x, T d, T asymmetry)
 {
+	asymmetry = Max(asymmetry, T(DISTORTION_ASYMMETRY_MIN));
+
+	if ((K & KERNEL_LUT_EXP) != 0)
+	{
+		if (x > 0.0)
+			return (LutExp(x * d) - 1.0) / (LutExp(d) - 1.0);
+
+		return -((LutExp(-x * d * (1.0 / asymmetry)) - 1.0) / (LutExp(d * (1.0 / asymmetry)) - 1.0)) * asymmetry;
+	}
+
 	if (x > 0.0)
 		return (exp(x * d) - 1.0) / (exp(d) - 1.0);
 
@@ -94,33 +192,96 @@ inline double Distortion(double x, double d, double asymmetry)
 }
 
 
+template <typename T, unsigned K = 0> class BasicEasingCurve
+{
+	// 'ExponentialEasing()' with its constant part computed once, for when
+	// 'a' isn't known at compile time. Same results
+  public:
+	BasicEasingCurve(T a)
+	{
+		m_a = a;
+		m_d = exp(a) - 1.0;
+	}
+
+	T operator()(T x) const
+	{
+		if ((K & KERNEL_FAST_EXP) != 0)
+			return ExponentialEasing<T, K>(x, m_a);
+
+		return ((exp(m_a * fabs(x)) - 1.0) / m_d) * Sign(x);
+	}
+
+  private:
+	T m_a;
+	T m_d;
+};
+
+template <typename T, unsigned K = 0> class BasicDistortionCurve
+{
+	// Same for 'Distortion()'
+  public:
+	BasicDistortionCurve(T d, T asymmetry)
+	{
+		m_d = d;
+		m_asymmetry = Max(asymmetry, T(DISTORTION_ASYMMETRY_MIN));
+		m_r = 1.0 / m_asymmetry;
+		m_positive = exp(d) - 1.0;
+		m_negative = exp(d * m_r) - 1.0;
+	}
+
+	T operator()(T x) const
+	{
+		if ((K & KERNEL_LUT_EXP) != 0)
+			return Distortion<T, K>(x, m_d, m_asymmetry);
+
+		if (x > 0.0)
+			return (exp(x * m_d) - 1.0) / m_positive;
+
+		return -((exp(-x * m_d * m_r) - 1.0) / m_negative) * m_asymmetry;
+	}
+
+  private:
+	T m_d;
+	T m_asymmetry;
+	T m_r;
+	T m_positive;
+	T m_negative;
+};
+
+using EasingCurve = BasicEasingCurve<double>;
+using DistortionCurve = BasicDistortionCurve<double>;
+
+
 enum class FilterType
 {
 	Lowpass,
 	Highpass
 };
 
-template <FilterType TYPE> class OnePoleFilter
+template <FilterType TYPE, typename T = double> class OnePoleFilter
 {
   public:
-	OnePoleFilter(double cutoff, double sampling_frequency)
+	OnePoleFilter(T cutoff, double sampling_frequency)
 	{
 		m_s = 0.0;
 		m_c = 1.0 - exp((-M_PI * 2.0) * (cutoff / sampling_frequency));
 	}
 
-	double Step(double x)
+	T Step(T x)
 	{
 		m_s += (x - m_s) * m_c;
 		return (TYPE == FilterType::Lowpass) ? (m_s) : (x - m_s);
 	}
 
   private:
-	double m_s;
-	double m_c;
+	T m_s;
+	T m_c;
 };
 
-template <FilterType TYPE> class TwoPolesFilter
+static constexpr double TWO_POLES_CUTOFF_MAX = 0.49; // Of the sampling frequency
+static constexpr double TWO_POLES_Q_MIN = 1e-3;
+
+template <FilterType TYPE, typename T = double> class TwoPolesFilter
 {
 	static constexpr size_t X1 = 0; // To use as indices
 	static constexpr size_t Y1 = 1;
@@ -133,15 +294,17 @@ template <FilterType TYPE> class TwoPolesFilter
 	static constexpr size_t A2 = Y2;
 
   public:
-	TwoPolesFilter(double cutoff, double q, double sampling_frequency)
+	TwoPolesFilter(T cutoff, T q, double sampling_frequency)
 	{
 		// Cookbook formulae for audio equalizer biquad filter coefficients
 		// Robert Bristow-Johnson
 		// https://webaudio.github.io/Audio-EQ-Cookbook/audio-eq-cookbook.html
 
-		const double wo = (2.0 * M_PI) * (cutoff / sampling_frequency);
-		const double alpha = sin(wo) / (2.0 * q);
-		double a0 = 1.0;
+		// Past Nyquist 'sin(wo)' goes negative, and poles out of the unit
+		// circle. Same with a negative Q, a zero one divides by zero
+		const T wo = (2.0 * M_PI) * Clamp(cutoff / sampling_frequency, T(0.0), T(TWO_POLES_CUTOFF_MAX));
+		const T alpha = sin(wo) / (2.0 * Max(q, T(TWO_POLES_Q_MIN)));
+		T a0 = 1.0;
 
 		m_s[0] = 0.0;
 		m_s[1] = 0.0;
@@ -188,9 +351,9 @@ template <FilterType TYPE> class TwoPolesFilter
 		m_c[A2] = -m_c[A2];
 	}
 
-	double Step(double x)
+	T Step(T x)
 	{
-		const double y = (m_c_b0 * x)                                //
+		const T y = (m_c_b0 * x)                                     //
 		                 + (m_c[B1] * m_s[X1]) + (m_c[B2] * m_s[X2]) // [a]
 		                 + (m_c[A1] * m_s[Y1]) + (m_c[A2] * m_s[Y2]);
 
@@ -203,28 +366,30 @@ template <FilterType TYPE> class TwoPolesFilter
 	}
 
   private:
-	double m_c[4];
-	double m_s[4];
-	double m_c_b0;
+	T m_c[4];
+	T m_s[4];
+	T m_c_b0;
 };
 
 
-class AdEnvelope
+template <typename T> class BasicAdEnvelope
 {
   public:
-	AdEnvelope(double attack_duration, double decay_duration, double sampling_frequency)
+	BasicAdEnvelope(T attack_duration, T decay_duration, double sampling_frequency)
 	{
-		m_attack = static_cast<double>(MillisecondsToSamples(attack_duration, sampling_frequency));
-		m_decay = static_cast<double>(MillisecondsToSamples(decay_duration, sampling_frequency));
+		m_attack = Quantized((attack_duration * sampling_frequency) / 1000.0,
+		                     static_cast<double>(MillisecondsToSamples(Value(attack_duration), sampling_frequency)));
+		m_decay = Quantized((decay_duration * sampling_frequency) / 1000.0,
+		                    static_cast<double>(MillisecondsToSamples(Value(decay_duration), sampling_frequency)));
 	}
 
 	int GetTotalSamples() const
 	{
-		return static_cast<int>(ceil(m_attack + m_decay));
+		return static_cast<int>(ceil(Value(m_attack) + Value(m_decay)));
 	}
 
 	template <typename LAMBDA1, typename LAMBDA2> // 'std::function' incurs in lot of allocations
-	double Get(int x, LAMBDA1 a_easing, LAMBDA2 d_easing)
+	T Get(int x, LAMBDA1 a_easing, LAMBDA2 d_easing)
 	{
 		const double dx = static_cast<double>(x);
 
@@ -233,14 +398,16 @@ class AdEnvelope
 		else if (dx < m_attack + m_decay)
 			return d_easing(1.0 - (dx - m_attack) / m_decay);
 
-		return 0.0;
+		return T(0.0);
 	}
 
   private:
-	double m_attack;
-	double m_decay;
+	T m_attack;
+	T m_decay;
 };
 
+using AdEnvelope = BasicAdEnvelope<double>;
+
 
 class NoiseGenerator
 {
@@ -266,52 +433,55 @@ class NoiseGenerator
 };
 
 
-class Oscillator
+template <typename T, unsigned K = 0> class BasicOscillator
 {
   public:
-	Oscillator(double frequency_a, double frequency_b, double feedback_level_a, double feedback_level_b,
-	           double duration, double sampling_frequency)
+	BasicOscillator(T frequency_a, T frequency_b, T feedback_level_a, T feedback_level_b, T duration,
+	                double sampling_frequency)
 	{
 		m_phase = 0.0;
 		m_phase_delta_a = (frequency_a / sampling_frequency) * M_PI_TWO;
 		m_phase_delta_b = (frequency_b / sampling_frequency) * M_PI_TWO;
 
 		m_sweep = 0.0;
-		m_sweep_delta = 1.0 / static_cast<double>(MillisecondsToSamples(duration, sampling_frequency));
+		const int samples = MillisecondsToSamples(Value(duration), sampling_frequency);
+		m_sweep_delta = 1.0 / Quantized((duration * sampling_frequency) / 1000.0, static_cast<double>(samples));
 
 		m_feedback = 0.0;
 		m_feedback_level_a = feedback_level_a / (M_PI / 2.0); // For a maximum 'feedback_level' of 1
 		m_feedback_level_b = feedback_level_b / (M_PI / 2.0); // Ditto
 	}
 
-	template <typename LAMBDA> double Step(LAMBDA s_easing)
+	template <typename LAMBDA> T Step(LAMBDA s_easing)
 	{
-		const double s = Min(s_easing(m_sweep), 1.0);
-		const double phase_delta = Mix(m_phase_delta_a, m_phase_delta_b, s);
-		const double feedback_level = Mix(m_feedback_level_a, m_feedback_level_b, s);
+		const T s = Min(T(s_easing(m_sweep)), T(1.0));
+		const T phase_delta = Mix(m_phase_delta_a, m_phase_delta_b, s);
+		const T feedback_level = Mix(m_feedback_level_a, m_feedback_level_b, s);
 
 		m_phase = fmod(m_phase + phase_delta, M_PI_TWO);
-		m_sweep = Min(m_sweep + m_sweep_delta, 1.0);
+		m_sweep = Min(m_sweep + m_sweep_delta, T(1.0));
 
-		const double signal = sin(m_phase + m_feedback);
+		const T signal = ((K & KERNEL_FAST_SIN) != 0) ? FastSin(m_phase + m_feedback) : sin(m_phase + m_feedback);
 		m_feedback = (m_feedback + signal) * feedback_level;
 
 		return signal;
 	}
 
   private:
-	double m_phase;
-	double m_phase_delta_a;
-	double m_phase_delta_b;
+	T m_phase;
+	T m_phase_delta_a;
+	T m_phase_delta_b;
 
-	double m_sweep;
-	double m_sweep_delta;
+	T m_sweep;
+	T m_sweep_delta;
 
-	double m_feedback;
-	double m_feedback_level_a;
-	double m_feedback_level_b;
+	T m_feedback;
+	T m_feedback_level_a;
+	T m_feedback_level_b;
 };
 
+using Oscillator = BasicOscillator<double>;
+
 
 class SquareOscillator
 {
@@ -334,61 +504,486 @@ class SquareOscillator
 };
 
 
-inline void ExportS24(const double* input, double sampling_frequency, size_t length, const char* filename)
+template <typename T> class BasicOutput
 {
-	auto export_buffer = reinterpret_cast<uint8_t*>(malloc(sizeof(uint8_t) * 3 * length));
-	if (export_buffer == nullptr)
-		return;
+	// Where renders go, a buffer, or blocks handed to 'flush' as they fill
+  public:
+	using FlushFunction = void (*)(const T* samples, size_t length, void* user_data);
 
-	// Convert to s24
+	BasicOutput(T* buffer, size_t size, FlushFunction flush = nullptr, void* user_data = nullptr)
 	{
-		uint8_t* out = export_buffer;
-		uint32_t conversion;
-		for (const double* in = input; in < (input + length); in += 1)
-		{
-			const auto v = static_cast<int32_t>((*in) * 127.0 * 8388607.0);
-			memcpy(&conversion, &v, sizeof(int32_t));
-			conversion >>= 7;
+		m_buffer = buffer;
+		m_size = size;
+		m_cursor = 0;
+		m_length = 0;
 
-			*out++ = static_cast<uint8_t>((conversion >> 0) & 0xFF);
-			*out++ = static_cast<uint8_t>((conversion >> 8) & 0xFF);
-			*out++ = static_cast<uint8_t>((conversion >> 16) & 0xFF);
+		m_flush = flush;
+		m_user_data = user_data;
+	}
+
+	void Put(T x)
+	{
+		if (m_cursor == m_size)
+		{
+			if (m_flush == nullptr)
+				return; // Full, and nowhere to go
+			Flush();
 		}
+
+		m_buffer[m_cursor] = x;
+		m_cursor += 1;
+		m_length += 1;
 	}
 
-	// Encode
+	void Flush()
 	{
-		drwav_data_format format;
-		format.container = drwav_container_riff;
-		format.format = DR_WAVE_FORMAT_PCM;
-		format.channels = 1;
-		format.sampleRate = static_cast<drwav_uint32>(sampling_frequency);
-		format.bitsPerSample = 24;
+		if (m_flush == nullptr || m_cursor == 0)
+			return;
 
-		drwav wav;
-		drwav_init_file_write(&wav, filename, &format, nullptr);
-		drwav_write_pcm_frames(&wav, static_cast<drwav_uint64>(length), export_buffer);
-		drwav_uninit(&wav);
+		m_flush(m_buffer, m_cursor, m_user_data);
+		m_cursor = 0;
 	}
 
-	// Bye!
-	free(export_buffer);
-}
+	size_t GetLength() const
+	{
+		return m_length;
+	}
+
+  private:
+	T* m_buffer;
+	size_t m_size;
+	size_t m_cursor;
+	size_t m_length;
+
+	FlushFunction m_flush;
+	void* m_user_data;
+};
+
+using Output = BasicOutput<double>;
 
 
-inline void ExportF64(const double* input, double sampling_frequency, size_t length, const char* filename)
+class RenderBuffer
 {
-	drwav_data_format format;
-	format.container = drwav_container_riff;
-	format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
-	format.channels = 1;
-	format.sampleRate = static_cast<drwav_uint32>(sampling_frequency);
-	format.bitsPerSample = 64;
-
-	drwav wav;
-	drwav_init_file_write(&wav, filename, &format, nullptr);
-	drwav_write_pcm_frames(&wav, static_cast<drwav_uint64>(length), input);
-	drwav_uninit(&wav);
+	// Cache line aligned, so Simd loads never split lines
+  public:
+	static constexpr size_t ALIGNMENT = 64;
+
+	RenderBuffer(size_t length = 0)
+	{
+		m_memory = nullptr;
+		m_data = nullptr;
+		m_length = 0;
+		Resize(length);
+	}
+
+	~RenderBuffer()
+	{
+		free(m_memory);
+	}
+
+	RenderBuffer(RenderBuffer&& other) noexcept
+	{
+		m_memory = other.m_memory;
+		m_data = other.m_data;
+		m_length = other.m_length;
+
+		other.m_memory = nullptr;
+		other.m_data = nullptr;
+		other.m_length = 0;
+	}
+
+	RenderBuffer& operator=(RenderBuffer&& other) noexcept
+	{
+		free(m_memory);
+
+		m_memory = other.m_memory;
+		m_data = other.m_data;
+		m_length = other.m_length;
+
+		other.m_memory = nullptr;
+		other.m_data = nullptr;
+		other.m_length = 0;
+		return *this;
+	}
+
+	RenderBuffer(const RenderBuffer&) = delete;
+	RenderBuffer& operator=(const RenderBuffer&) = delete;
+
+	bool Resize(size_t length)
+	{
+		// Contents not kept, zeroed instead
+		free(m_memory);
+		m_memory = nullptr;
+		m_data = nullptr;
+		m_length = 0;
+
+		if (length == 0)
+			return true;
+
+		m_memory = malloc(sizeof(double) * length + ALIGNMENT);
+		if (m_memory == nullptr)
+			return false;
+
+		const auto address = reinterpret_cast<uintptr_t>(m_memory);
+		m_data = reinterpret_cast<double*>((address + ALIGNMENT - 1) & ~static_cast<uintptr_t>(ALIGNMENT - 1));
+		m_length = length;
+
+		memset(m_data, 0, sizeof(double) * length);
+		return true;
+	}
+
+	double* GetData()
+	{
+		return m_data;
+	}
+
+	const double* GetData() const
+	{
+		return m_data;
+	}
+
+	size_t GetLength() const
+	{
+		return m_length;
+	}
+
+  private:
+	void* m_memory;
+	double* m_data;
+	size_t m_length;
+};
+
+
+inline int32_t ToS24(double x)
+{
+	// Same quantization as 'PutS24()', sign extended
+	uint32_t conversion;
+	const auto v = static_cast<int32_t>(x * 127.0 * 8388607.0);
+	memcpy(&conversion, &v, sizeof(int32_t));
+	conversion = (conversion >> 7) << 8;
+
+	int32_t s;
+	memcpy(&s, &conversion, sizeof(int32_t));
+	return s / 256;
 }
 
+inline uint8_t* PutS24(double x, uint8_t* out)
+{
+	uint32_t conversion;
+	const auto v = static_cast<int32_t>(x * 127.0 * 8388607.0);
+	memcpy(&conversion, &v, sizeof(int32_t));
+	conversion >>= 7;
+
+	*out++ = static_cast<uint8_t>((conversion >> 0) & 0xFF);
+	*out++ = static_cast<uint8_t>((conversion >> 8) & 0xFF);
+	*out++ = static_cast<uint8_t>((conversion >> 16) & 0xFF);
+	return out;
+}
+
+
+class PeakEnvelope
+{
+	// Broadcast Wave peak envelope, 'levl' chunk
+	// https://tech.ebu.ch/docs/tech/tech3285s3.pdf
+
+	static constexpr size_t HEADER_SIZE = 120; // Without chunk id and size
+
+  public:
+	static constexpr uint32_t BLOCK_SIZE = 256; // Frames per peak value, as the specification default
+
+	PeakEnvelope(size_t length)
+	{
+		m_chunk.reserve(HEADER_SIZE + ((length + BLOCK_SIZE - 1) / BLOCK_SIZE) * 4);
+		m_chunk.resize(HEADER_SIZE, 0);
+
+		m_position = 0;
+		m_block_position = 0;
+		m_block_max = 0.0;
+		m_block_min = 0.0;
+
+		m_peak = 0.0;
+		m_peak_position = 0;
+	}
+
+	void Step(double x)
+	{
+		m_block_max = Max(m_block_max, x);
+		m_block_min = Min(m_block_min, x);
+
+		if (fabs(x) > m_peak)
+		{
+			m_peak = fabs(x);
+			m_peak_position = m_position;
+		}
+
+		m_position += 1;
+		if ((m_block_position += 1) == BLOCK_SIZE)
+			Flush();
+	}
+
+	drwav_metadata Metadata()
+	{
+		if (m_block_position != 0)
+			Flush();
+
+		// Header, 'dwOffsetToPeaks' counts chunk id and size
+		WriteU32(0, 1);                                                             // dwVersion
+		WriteU32(4, 2);                                                             // dwFormat, unsigned short
+		WriteU32(8, 2);                                                             // dwPointsPerValue, both peaks
+		WriteU32(12, BLOCK_SIZE);                                                   // dwBlockSize
+		WriteU32(16, 1);                                                            // dwPeakChannels
+		WriteU32(20, static_cast<uint32_t>((m_chunk.size() - HEADER_SIZE) / 4));    // dwNumPeakFrames
+		WriteU32(24, (m_peak > 0.0) ? m_peak_position : static_cast<uint32_t>(~0)); // dwPosPeakOfPeaks
+		WriteU32(28, static_cast<uint32_t>(HEADER_SIZE + 8));                       // dwOffsetToPeaks
+		// Timestamp left empty, so equal renders produce equal files
+
+		drwav_metadata metadata = {};
+		metadata.type = drwav_metadata_type_unknown;
+		metadata.data.unknown.id[0] = 'l';
+		metadata.data.unknown.id[1] = 'e';
+		metadata.data.unknown.id[2] = 'v';
+		metadata.data.unknown.id[3] = 'l';
+		metadata.data.unknown.chunkLocation = drwav_metadata_location_top_level;
+		metadata.data.unknown.dataSizeInBytes = static_cast<drwav_uint32>(m_chunk.size());
+		metadata.data.unknown.pData = m_chunk.data();
+
+		return metadata;
+	}
+
+  private:
+	std::vector<uint8_t> m_chunk;
+
+	uint32_t m_position;
+	uint32_t m_block_position;
+	double m_block_max;
+	double m_block_min;
+
+	double m_peak;
+	uint32_t m_peak_position;
+
+	void Flush()
+	{
+		// Absolute values, positive peak first
+		const auto max = static_cast<uint16_t>(Clamp(m_block_max, 0.0, 1.0) * 32767.0 + 0.5);
+		const auto min = static_cast<uint16_t>(Clamp(-m_block_min, 0.0, 1.0) * 32767.0 + 0.5);
+
+		m_chunk.push_back(static_cast<uint8_t>(max & 0xFF));
+		m_chunk.push_back(static_cast<uint8_t>(max >> 8));
+		m_chunk.push_back(static_cast<uint8_t>(min & 0xFF));
+		m_chunk.push_back(static_cast<uint8_t>(min >> 8));
+
+		m_block_position = 0;
+		m_block_max = 0.0;
+		m_block_min = 0.0;
+	}
+
+	void WriteU32(size_t offset, uint32_t v)
+	{
+		m_chunk[offset + 0] = static_cast<uint8_t>((v >> 0) & 0xFF);
+		m_chunk[offset + 1] = static_cast<uint8_t>((v >> 8) & 0xFF);
+		m_chunk[offset + 2] = static_cast<uint8_t>((v >> 16) & 0xFF);
+		m_chunk[offset + 3] = static_cast<uint8_t>((v >> 24) & 0xFF);
+	}
+};
+
+
+class LoudnessMeter
+{
+	// Sample peak, true peak, rms and integrated loudness, ITU-R BS.1770-4 / EBU R128
+	// https://www.itu.int/rec/R-REC-BS.1770
+
+	static constexpr size_t TRUE_PEAK_BLOCK = 256; // Samples oversampled at once, by kernel of 'dispatch.hpp'
+
+  public:
+	LoudnessMeter(double sampling_frequency, size_t length) // Blocks reserved for 'length' samples
+	{
+		// K-weighting, first a shelf then a highpass. As BS.1770 only gives
+		// coefficients for 48 kHz, these are the ones of libebur128 that
+		// derive them for any frequency
+		{
+			const double f0 = 1681.974450955533;
+			const double g = 3.999843853973347;
+			const double q = 0.7071752369554196;
+
+			const double k = tan(M_PI * f0 / sampling_frequency);
+			const double vh = pow(10.0, g / 20.0);
+			const double vb = pow(vh, 0.4996667741545416);
+			const double a0 = 1.0 + k / q + k * k;
+
+			m_shelf_b[0] = (vh + vb * k / q + k * k) / a0;
+			m_shelf_b[1] = 2.0 * (k * k - vh) / a0;
+			m_shelf_b[2] = (vh - vb * k / q + k * k) / a0;
+			m_shelf_a[0] = 2.0 * (k * k - 1.0) / a0;
+			m_shelf_a[1] = (1.0 - k / q + k * k) / a0;
+		}
+		{
+			const double f0 = 38.13547087602444;
+			const double q = 0.5003270373238773;
+
+			const double k = tan(M_PI * f0 / sampling_frequency);
+			const double a0 = 1.0 + k / q + k * k;
+
+			m_hp_a[0] = 2.0 * (k * k - 1.0) / a0;
+			m_hp_a[1] = (1.0 - k / q + k * k) / a0;
+		}
+
+		for (size_t i = 0; i < 4; i += 1)
+		{
+			m_shelf_s[i] = 0.0;
+			m_hp_s[i] = 0.0;
+		}
+
+		for (size_t i = 0; i < TRUE_PEAK_TAPS - 1; i += 1)
+			m_history[i] = 0.0;
+		m_history_length = 0;
+		m_true_peak_kernel = GetKernels().true_peak;
+
+		m_block_length = static_cast<size_t>(sampling_frequency / 10.0); // 100 ms, a quarter of gating blocks
+		m_block_cursor = 0;
+		m_block_sum = 0.0;
+		m_blocks.reserve(length / Max(m_block_length, static_cast<size_t>(1)) + 1);
+
+		m_length = 0;
+		m_sum = 0.0;
+		m_sample_peak = 0.0;
+		m_true_peak = 0.0;
+	}
+
+	void Step(double x)
+	{
+		// Peak, rms
+		m_sample_peak = Max(m_sample_peak, fabs(x));
+		m_sum += x * x;
+		m_length += 1;
+
+		// True peak, over blocks. Last samples of one kept ahead of the next,
+		// windows always contiguous
+		m_history[TRUE_PEAK_TAPS - 1 + m_history_length] = x;
+		if ((m_history_length += 1) == TRUE_PEAK_BLOCK)
+		{
+			m_true_peak = Max(m_true_peak, m_true_peak_kernel(m_history, TRUE_PEAK_BLOCK));
+			memcpy(m_history, m_history + TRUE_PEAK_BLOCK, sizeof(double) * (TRUE_PEAK_TAPS - 1));
+			m_history_length = 0;
+		}
+
+		// Loudness
+		double y = (m_shelf_b[0] * x) + (m_shelf_b[1] * m_shelf_s[0]) + (m_shelf_b[2] * m_shelf_s[1]) //
+		           - (m_shelf_a[0] * m_shelf_s[2]) - (m_shelf_a[1] * m_shelf_s[3]);
+		m_shelf_s[1] = m_shelf_s[0];
+		m_shelf_s[0] = x;
+		m_shelf_s[3] = m_shelf_s[2];
+		m_shelf_s[2] = y;
+
+		x = y;
+		y = x - 2.0 * m_hp_s[0] + m_hp_s[1] - (m_hp_a[0] * m_hp_s[2]) - (m_hp_a[1] * m_hp_s[3]);
+		m_hp_s[1] = m_hp_s[0];
+		m_hp_s[0] = x;
+		m_hp_s[3] = m_hp_s[2];
+		m_hp_s[2] = y;
+
+		m_block_sum += y * y;
+		if ((m_block_cursor += 1) == m_block_length)
+		{
+			m_blocks.push_back(m_block_sum);
+			m_block_cursor = 0;
+			m_block_sum = 0.0;
+		}
+	}
+
+	// In dB, -HUGE_VAL for silence
+	double GetSamplePeak() const
+	{
+		return 20.0 * log10(m_sample_peak);
+	}
+
+	double GetTruePeak() const
+	{
+		// Plus what is left of the last block
+		const double pending = m_true_peak_kernel(m_history, m_history_length);
+		return 20.0 * log10(Max(Max(m_true_peak, pending), m_sample_peak));
+	}
+
+	double GetRms() const
+	{
+		return 10.0 * log10(m_sum / static_cast<double>(Max(m_length, static_cast<size_t>(1))));
+	}
+
+	double GetIntegratedLoudness() const
+	{
+		// Gating blocks of 400 ms overlapping by 75%. Samples shorter than
+		// one block (a closed hat is) measure as a single partial block
+		std::vector<double> z;
+		for (size_t i = 3; i < m_blocks.size(); i += 1)
+		{
+			const double sum = m_blocks[i - 3] + m_blocks[i - 2] + m_blocks[i - 1] + m_blocks[i];
+			z.push_back(sum / static_cast<double>(m_block_length * 4));
+		}
+
+		if (z.size() == 0)
+		{
+			double sum = m_block_sum;
+			for (const double b : m_blocks)
+				sum += b;
+			z.push_back(sum / static_cast<double>(Max(m_length, static_cast<size_t>(1))));
+		}
+
+		// Absolute gate at -70 LUFS, then relative one 10 LU below what passed
+		const auto gated_mean = [&](double threshold)
+		{
+			double sum = 0.0;
+			size_t n = 0;
+			for (const double v : z)
+			{
+				if (-0.691 + 10.0 * log10(v) > threshold)
+				{
+					sum += v;
+					n += 1;
+				}
+			}
+			return (n > 0) ? sum / static_cast<double>(n) : 0.0;
+		};
+
+		const double absolute = gated_mean(-70.0);
+		if (absolute == 0.0)
+			return -HUGE_VAL;
+
+		return -0.691 + 10.0 * log10(gated_mean(-0.691 + 10.0 * log10(absolute) - 10.0));
+	}
+
+  private:
+	double m_shelf_b[3];
+	double m_shelf_a[2];
+	double m_shelf_s[4];
+	double m_hp_a[2]; // Its 'b' being 1, -2, 1
+	double m_hp_s[4];
+
+	double m_history[TRUE_PEAK_TAPS - 1 + TRUE_PEAK_BLOCK];
+	size_t m_history_length; // Past the first 'TRUE_PEAK_TAPS - 1'
+	double (*m_true_peak_kernel)(const double* x, size_t windows);
+
+	std::vector<double> m_blocks; // Sums of squares, of 100 ms each
+	size_t m_block_length;
+	size_t m_block_cursor;
+	double m_block_sum;
+
+	size_t m_length;
+	double m_sum;
+	double m_sample_peak;
+	double m_true_peak;
+};
+
+
+// Export and import, compiled once in 'matsu.cpp' (the 'matsu_core' library)
+// along with the dr_wav implementation
+
+void WriteLoudnessReport(const LoudnessMeter& meter, double sampling_frequency, size_t length, const char* filename);
+
+void EncodeWav(const drwav_data_format* format, const void* data, size_t length, PeakEnvelope* peaks,
+               const char* filename);
+
+void ExportS24(const double* input, double sampling_frequency, size_t length, const char* filename);
+void ExportF64(const double* input, double sampling_frequency, size_t length, const char* filename);
+
+bool ImportWav(const char* filename, RenderBuffer* out, double* sampling_frequency);
+
 #endif
@@ -0,0 +1,323 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_PERCEPTUAL_HPP
+#define MATSU_PERCEPTUAL_HPP
+
+#include "spectral.hpp"
+
+// Perceptual features: mel spectrogram, Mfcc, onset envelope, and a distance
+// combining them. Cheap enough to run on every candidate of a parameter
+// search: analysis state allocated once, evaluations don't allocate once
+// feature vectors have grown to size.
+
+
+static constexpr double PERCEPTUAL_FLOOR_DB = -100.0; // A full scale sine peaks at about 0 dB
+
+inline double HzToMel(double hz)
+{
+	return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+inline double MelToHz(double mel)
+{
+	return 700.0 * (pow(10.0, mel / 2595.0) - 1.0);
+}
+
+inline double Dot(const double* a, const double* b, size_t n)
+{
+	// Kernel of 'dispatch.hpp', last bits depending on the level in use
+	return GetKernels().dot(a, b, n);
+}
+
+
+class MelFilterbank
+{
+	// Triangular filters equally spaced in mel, overlapping by half, peaks
+	// of one. Sparse, each one only over the bins it covers. Filters
+	// narrower than a bin take the nearest one whole
+  public:
+	MelFilterbank(size_t bins, double sampling_frequency, size_t bands = 40, double low = 30.0,
+	              double high = 16000.0)
+	{
+		const double bin_width = sampling_frequency / static_cast<double>((bins - 1) * 2);
+		const double mel_low = HzToMel(low);
+		const double mel_high = HzToMel(Min(high, sampling_frequency / 2.0));
+
+		std::vector<double> edges(bands + 2);
+		for (size_t i = 0; i < edges.size(); i += 1)
+		{
+			const double x = static_cast<double>(i) / static_cast<double>(bands + 1);
+			edges[i] = MelToHz(mel_low + (mel_high - mel_low) * x);
+		}
+
+		m_bins = bins;
+		m_first.resize(bands);
+		m_count.resize(bands);
+		m_offset.resize(bands);
+
+		for (size_t b = 0; b < bands; b += 1)
+		{
+			const double left = edges[b];
+			const double center = edges[b + 1];
+			const double right = edges[b + 2];
+
+			m_first[b] = Min(static_cast<size_t>(ceil(left / bin_width)), bins - 1);
+			m_offset[b] = m_weights.size();
+
+			for (size_t i = m_first[b]; i < bins && static_cast<double>(i) * bin_width < right; i += 1)
+			{
+				const double f = static_cast<double>(i) * bin_width;
+				m_weights.push_back((f < center) ? (f - left) / (center - left) : (right - f) / (right - center));
+			}
+
+			m_count[b] = m_weights.size() - m_offset[b];
+			if (m_count[b] == 0 || Dot(&m_weights[m_offset[b]], &m_weights[m_offset[b]], m_count[b]) == 0.0)
+			{
+				m_weights.resize(m_offset[b]);
+				m_first[b] = Min(static_cast<size_t>(round(center / bin_width)), bins - 1);
+				m_count[b] = 1;
+				m_weights.push_back(1.0);
+			}
+		}
+	}
+
+	size_t GetBands() const
+	{
+		return m_first.size();
+	}
+
+	void Apply(const double* power, size_t frames, double scale, std::vector<double>* out) const
+	{
+		// Power frame after frame of bins, scaled, into dB frame after frame
+		// of bands. Floored at 'PERCEPTUAL_FLOOR_DB'
+		const size_t bands = m_first.size();
+		out->resize(frames * bands);
+
+		for (size_t f = 0; f < frames; f += 1)
+		{
+			const double* p = power + f * m_bins;
+			double* o = out->data() + f * bands;
+
+			for (size_t b = 0; b < bands; b += 1)
+			{
+				const double e = Dot(p + m_first[b], &m_weights[m_offset[b]], m_count[b]) * scale;
+				o[b] = Max(10.0 * log10(e + 1e-30), PERCEPTUAL_FLOOR_DB);
+			}
+		}
+	}
+
+  private:
+	size_t m_bins;
+	std::vector<size_t> m_first;
+	std::vector<size_t> m_count;
+	std::vector<size_t> m_offset;
+	std::vector<double> m_weights;
+};
+
+
+class Mfcc
+{
+	// Orthonormal Dct-II of mel bands in dB, first 'coefficients'. Those
+	// being in dB too (not natural log, as often), distances between them
+	// read as level differences
+  public:
+	Mfcc(size_t bands, size_t coefficients = 13)
+	{
+		m_bands = bands;
+		m_coefficients = Min(coefficients, bands);
+		m_table.resize(m_coefficients * bands);
+
+		for (size_t c = 0; c < m_coefficients; c += 1)
+		{
+			const double norm = sqrt(((c == 0) ? 1.0 : 2.0) / static_cast<double>(bands));
+			for (size_t b = 0; b < bands; b += 1)
+			{
+				m_table[c * bands + b] = norm * cos(M_PI / static_cast<double>(bands) *
+				                                    (static_cast<double>(b) + 0.5) * static_cast<double>(c));
+			}
+		}
+	}
+
+	size_t GetCoefficients() const
+	{
+		return m_coefficients;
+	}
+
+	void Apply(const double* mel, size_t frames, std::vector<double>* out) const
+	{
+		out->resize(frames * m_coefficients);
+		for (size_t f = 0; f < frames; f += 1)
+			for (size_t c = 0; c < m_coefficients; c += 1)
+				(*out)[f * m_coefficients + c] = Dot(mel + f * m_bands, &m_table[c * m_bands], m_bands);
+	}
+
+  private:
+	size_t m_bands;
+	size_t m_coefficients;
+	std::vector<double> m_table;
+};
+
+
+inline void OnsetEnvelope(const double* mel, size_t frames, size_t bands, std::vector<double>* out)
+{
+	// Spectral flux: mean over bands of level rises from the previous frame,
+	// in dB. Before the first one silence, an attack at the start counts
+	out->resize(frames);
+	for (size_t f = 0; f < frames; f += 1)
+	{
+		double sum = 0.0;
+		for (size_t b = 0; b < bands; b += 1)
+		{
+			const double previous = (f != 0) ? mel[(f - 1) * bands + b] : PERCEPTUAL_FLOOR_DB;
+			sum += Max(mel[f * bands + b] - previous, 0.0);
+		}
+
+		(*out)[f] = sum / static_cast<double>(bands);
+	}
+}
+
+
+struct PerceptualFeatures
+{
+	size_t frames = 0;
+	size_t bands = 0;
+	size_t coefficients = 0;
+
+	std::vector<double> mel;   // dB, frame after frame of bands
+	std::vector<double> mfcc;  // Frame after frame of coefficients
+	std::vector<double> onset; // One per frame
+};
+
+class PerceptualAnalysis
+{
+	// One per thread, holds analysis state
+  public:
+	PerceptualAnalysis(double sampling_frequency, size_t frame_length = 1024, size_t hop = 256, size_t bands = 40,
+	                   size_t coefficients = 13)
+	    : m_stft(frame_length, hop, Window::Hann),
+	      m_filterbank(m_stft.GetBins(), sampling_frequency, bands),
+	      m_mfcc(bands, coefficients)
+	{
+		// Hann window sums to half the frame, a sine of amplitude 'a' then
+		// peaks at a power of '(a * n / 4)^2'
+		const double n = static_cast<double>(m_stft.GetFrameLength());
+		m_scale = 16.0 / (n * n);
+	}
+
+	void Analyse(const double* in, size_t length, PerceptualFeatures* out)
+	{
+		out->frames = m_stft.Power(in, length, &m_power);
+		out->bands = m_filterbank.GetBands();
+		out->coefficients = m_mfcc.GetCoefficients();
+
+		m_filterbank.Apply(m_power.data(), out->frames, m_scale, &out->mel);
+		m_mfcc.Apply(out->mel.data(), out->frames, &out->mfcc);
+		OnsetEnvelope(out->mel.data(), out->frames, out->bands, &out->onset);
+	}
+
+  private:
+	Stft m_stft;
+	MelFilterbank m_filterbank;
+	Mfcc m_mfcc;
+	double m_scale;
+
+	std::vector<double> m_power;
+};
+
+
+enum PerceptualComponent
+{
+	PERCEPTUAL_MEL,   // Mean abs difference of mel bands, dB
+	PERCEPTUAL_MFCC,  // Spectral envelope shape (Mfcc without the first), dB per band
+	PERCEPTUAL_ONSET, // Mean abs difference of onset envelopes, dB
+	PERCEPTUAL_COMPONENTS_NO
+};
+
+struct PerceptualWeights
+{
+	double mel = 1.0;
+	double mfcc = 1.0;
+	double onset = 2.0; // Smaller values, being differences already
+};
+
+inline double PerceptualDistance(const PerceptualFeatures& a, const PerceptualFeatures& b,
+                                 const PerceptualWeights& weights = PerceptualWeights(),
+                                 double* components = nullptr)
+{
+	// Both from analyses of the same settings. Over the frames of the
+	// longest, the shortest continuing in silence. Frames silent in both
+	// don't count
+	const size_t bands = a.bands;
+	const size_t coefficients = a.coefficients;
+
+	double mel = 0.0;
+	double mfcc = 0.0;
+	double onset = 0.0;
+	size_t active = 0;
+
+	for (size_t f = 0; f < Max(a.frames, b.frames); f += 1)
+	{
+		const bool in_a = (f < a.frames);
+		const bool in_b = (f < b.frames);
+
+		double frame_mel = 0.0;
+		bool audible = false;
+		for (size_t i = 0; i < bands; i += 1)
+		{
+			const double ea = (in_a == true) ? a.mel[f * bands + i] : PERCEPTUAL_FLOOR_DB;
+			const double eb = (in_b == true) ? b.mel[f * bands + i] : PERCEPTUAL_FLOOR_DB;
+
+			frame_mel += fabs(ea - eb);
+			audible = audible || Max(ea, eb) > PERCEPTUAL_FLOOR_DB;
+		}
+
+		if (audible == false)
+			continue;
+
+		// Silence has a flat envelope, all coefficients but the first zero
+		double frame_mfcc = 0.0;
+		for (size_t c = 1; c < coefficients; c += 1)
+		{
+			const double ca = (in_a == true) ? a.mfcc[f * coefficients + c] : 0.0;
+			const double cb = (in_b == true) ? b.mfcc[f * coefficients + c] : 0.0;
+			frame_mfcc += (ca - cb) * (ca - cb);
+		}
+
+		const double oa = (in_a == true) ? a.onset[f] : 0.0;
+		const double ob = (in_b == true) ? b.onset[f] : 0.0;
+
+		mel += frame_mel / static_cast<double>(bands);
+		mfcc += sqrt(frame_mfcc / static_cast<double>(bands));
+		onset += fabs(oa - ob);
+		active += 1;
+	}
+
+	if (active != 0)
+	{
+		mel /= static_cast<double>(active);
+		mfcc /= static_cast<double>(active);
+		onset /= static_cast<double>(active);
+	}
+
+	if (components != nullptr)
+	{
+		components[PERCEPTUAL_MEL] = mel;
+		components[PERCEPTUAL_MFCC] = mfcc;
+		components[PERCEPTUAL_ONSET] = onset;
+	}
+
+	return weights.mel * mel + weights.mfcc * mfcc + weights.onset * onset;
+}
+
+#endif
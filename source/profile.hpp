@@ -0,0 +1,156 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_PROFILE_HPP
+#define MATSU_PROFILE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Time per named stage of render loops. Only with 'MATSU_PROFILE' defined,
+// otherwise 'MATSU_PROFILE_SCOPE()' expands to nothing. Single thread,
+// counters aren't atomic. Ticks being time stamp counter cycles where
+// there is one, nanoseconds otherwise
+
+#ifdef MATSU_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MATSU_PROFILE_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define MATSU_PROFILE_TSC
+#elif defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#else
+#include <chrono>
+#endif
+
+
+inline uint64_t ProfileTicks()
+{
+#if defined(MATSU_PROFILE_TSC)
+	return static_cast<uint64_t>(__rdtsc());
+#elif defined(__unix__) || defined(__APPLE__)
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return static_cast<uint64_t>(t.tv_sec) * 1000000000 + static_cast<uint64_t>(t.tv_nsec);
+#else
+	return static_cast<uint64_t>(
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+	        .count());
+#endif
+}
+
+
+struct ProfileStage
+{
+	const char* name;
+	uint64_t ticks;
+	uint64_t calls;
+};
+
+static constexpr size_t PROFILE_MAX_STAGES = 64;
+
+struct ProfileStages
+{
+	ProfileStage stages[PROFILE_MAX_STAGES];
+	size_t no;
+};
+
+inline ProfileStages& GetProfileStages()
+{
+	static ProfileStages stages = {};
+	return stages;
+}
+
+inline ProfileStage* ProfileRegister(const char* name)
+{
+	ProfileStages& s = GetProfileStages();
+	if (s.no == PROFILE_MAX_STAGES)
+		return nullptr; // Not profiled, still harmless
+
+	ProfileStage* stage = &s.stages[s.no];
+	s.no += 1;
+
+	stage->name = name;
+	stage->ticks = 0;
+	stage->calls = 0;
+	return stage;
+}
+
+inline void ProfileReset()
+{
+	ProfileStages& s = GetProfileStages();
+	for (size_t i = 0; i < s.no; i += 1)
+	{
+		s.stages[i].ticks = 0;
+		s.stages[i].calls = 0;
+	}
+}
+
+
+class ProfileScope
+{
+  public:
+	ProfileScope(ProfileStage* stage)
+	{
+		m_stage = stage;
+		m_start = ProfileTicks();
+	}
+
+	~ProfileScope()
+	{
+		const uint64_t end = ProfileTicks();
+		if (m_stage != nullptr)
+		{
+			m_stage->ticks += end - m_start;
+			m_stage->calls += 1;
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+  private:
+	ProfileStage* m_stage;
+	uint64_t m_start;
+};
+
+
+inline double ProfileOverhead()
+{
+	// Of an empty scope, to take out of every call
+	static ProfileStage calibration = {"Calibration", 0, 0};
+	calibration.ticks = 0;
+	calibration.calls = 0;
+
+	for (int i = 0; i < 100000; i += 1)
+		ProfileScope scope(&calibration);
+
+	return static_cast<double>(calibration.ticks) / static_cast<double>(calibration.calls);
+}
+
+
+#define MATSU_PROFILE_CONCAT2(a, b) a##b
+#define MATSU_PROFILE_CONCAT(a, b) MATSU_PROFILE_CONCAT2(a, b)
+
+#define MATSU_PROFILE_SCOPE(name)                                                                       \
+	static ProfileStage* const MATSU_PROFILE_CONCAT(profile_stage_, __LINE__) = ProfileRegister(name); \
+	ProfileScope MATSU_PROFILE_CONCAT(profile_scope_, __LINE__)(MATSU_PROFILE_CONCAT(profile_stage_, __LINE__))
+
+#else
+#define MATSU_PROFILE_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,322 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_SPECTRAL_HPP
+#define MATSU_SPECTRAL_HPP
+
+#include "matsu.hpp"
+
+// Spectral analysis: real Fft, Stft, energy in frequency bands. To compare
+// renders against each other or against recordings.
+
+
+class Fft
+{
+	// Real input of a power of two size. Done as a complex transform of half
+	// the size over even and odd samples (as real and imaginary parts), then
+	// split into the real spectrum. Real and imaginary parts in separate
+	// arrays, so butterflies are two of them at a time with Sse2
+  public:
+	Fft(size_t size)
+	{
+		m_size = 4;
+		while (m_size < size)
+			m_size <<= 1;
+
+		const size_t half = m_size / 2;
+		m_re.resize(half);
+		m_im.resize(half);
+
+		// Bit reversal permutation of the half size transform
+		size_t bits = 0;
+		while ((static_cast<size_t>(1) << bits) < half)
+			bits += 1;
+
+		m_reverse.resize(half);
+		for (size_t i = 0; i < half; i += 1)
+		{
+			size_t r = 0;
+			for (size_t b = 0; b < bits; b += 1)
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			m_reverse[i] = static_cast<uint32_t>(r);
+		}
+
+		// Twiddles of every stage one after the other, the stage of span
+		// '2h' using 'h' of them from 'h - 1'. Inner loops read them in order
+		m_twiddle_re.resize(half);
+		m_twiddle_im.resize(half);
+		for (size_t h = 1; h < half; h <<= 1)
+		{
+			for (size_t k = 0; k < h; k += 1)
+			{
+				const double angle = -M_PI * static_cast<double>(k) / static_cast<double>(h);
+				m_twiddle_re[h - 1 + k] = cos(angle);
+				m_twiddle_im[h - 1 + k] = sin(angle);
+			}
+		}
+
+		// To split the half size transform into the real one
+		m_split_re.resize(half + 1);
+		m_split_im.resize(half + 1);
+		for (size_t k = 0; k <= half; k += 1)
+		{
+			const double angle = -M_PI_TWO * static_cast<double>(k) / static_cast<double>(m_size);
+			m_split_re[k] = cos(angle);
+			m_split_im[k] = sin(angle);
+		}
+	}
+
+	size_t GetSize() const
+	{
+		return m_size;
+	}
+
+	size_t GetBins() const
+	{
+		return m_size / 2 + 1;
+	}
+
+	void Forward(const double* in, double* out_re, double* out_im)
+	{
+		// 'in' of 'GetSize()' samples, outputs of 'GetBins()'
+		const size_t half = m_size / 2;
+		double* re = m_re.data();
+		double* im = m_im.data();
+
+		for (size_t i = 0; i < half; i += 1)
+		{
+			re[m_reverse[i]] = in[i * 2];
+			im[m_reverse[i]] = in[i * 2 + 1];
+		}
+
+		for (size_t h = 1; h < half; h <<= 1)
+		{
+			const double* w_re = &m_twiddle_re[h - 1];
+			const double* w_im = &m_twiddle_im[h - 1];
+
+			for (size_t start = 0; start < half; start += h * 2)
+			{
+				double* a_re = re + start;
+				double* a_im = im + start;
+				double* b_re = a_re + h;
+				double* b_im = a_im + h;
+				size_t k = 0;
+
+#ifdef MATSU_SSE2
+				for (; k + 2 <= h; k += 2)
+				{
+					const __m128d wr = _mm_loadu_pd(w_re + k);
+					const __m128d wi = _mm_loadu_pd(w_im + k);
+					const __m128d br = _mm_loadu_pd(b_re + k);
+					const __m128d bi = _mm_loadu_pd(b_im + k);
+					const __m128d ar = _mm_loadu_pd(a_re + k);
+					const __m128d ai = _mm_loadu_pd(a_im + k);
+
+					const __m128d tr = _mm_sub_pd(_mm_mul_pd(br, wr), _mm_mul_pd(bi, wi));
+					const __m128d ti = _mm_add_pd(_mm_mul_pd(br, wi), _mm_mul_pd(bi, wr));
+
+					_mm_storeu_pd(a_re + k, _mm_add_pd(ar, tr));
+					_mm_storeu_pd(a_im + k, _mm_add_pd(ai, ti));
+					_mm_storeu_pd(b_re + k, _mm_sub_pd(ar, tr));
+					_mm_storeu_pd(b_im + k, _mm_sub_pd(ai, ti));
+				}
+#endif
+				for (; k < h; k += 1)
+				{
+					const double tr = b_re[k] * w_re[k] - b_im[k] * w_im[k];
+					const double ti = b_re[k] * w_im[k] + b_im[k] * w_re[k];
+
+					b_re[k] = a_re[k] - tr;
+					b_im[k] = a_im[k] - ti;
+					a_re[k] += tr;
+					a_im[k] += ti;
+				}
+			}
+		}
+
+		// Split, Z being the half size transform: even samples transform
+		// E = (Z[k] + conj(Z[half - k])) / 2, odd ones O = (Z[k] - conj(Z[half - k])) / 2i,
+		// and X[k] = E + O * W^k
+		for (size_t k = 0; k <= half; k += 1)
+		{
+			const size_t a = (k == half) ? 0 : k;
+			const size_t b = (k == 0) ? 0 : half - k;
+
+			const double e_re = (re[a] + re[b]) * 0.5;
+			const double e_im = (im[a] - im[b]) * 0.5;
+			const double o_re = (im[a] + im[b]) * 0.5;
+			const double o_im = (re[b] - re[a]) * 0.5;
+
+			out_re[k] = e_re + o_re * m_split_re[k] - o_im * m_split_im[k];
+			out_im[k] = e_im + o_re * m_split_im[k] + o_im * m_split_re[k];
+		}
+	}
+
+  private:
+	size_t m_size;
+
+	std::vector<double> m_re;
+	std::vector<double> m_im;
+	std::vector<uint32_t> m_reverse;
+
+	std::vector<double> m_twiddle_re;
+	std::vector<double> m_twiddle_im;
+	std::vector<double> m_split_re;
+	std::vector<double> m_split_im;
+};
+
+
+enum class Window
+{
+	Rectangular,
+	Hann,
+	Blackman
+};
+
+class Stft
+{
+	// Frames every 'hop' samples from the first one, until none is left.
+	// Past the end zeros. Output as power (squared magnitudes), frame after
+	// frame of 'GetBins()'
+  public:
+	Stft(size_t frame_length, size_t hop, Window window = Window::Hann) : m_fft(frame_length)
+	{
+		m_hop = Max(hop, static_cast<size_t>(1));
+		m_frame.resize(m_fft.GetSize());
+		m_re.resize(m_fft.GetBins());
+		m_im.resize(m_fft.GetBins());
+
+		// Periodic windows, for overlapping frames
+		const double n = static_cast<double>(m_fft.GetSize());
+		m_window.resize(m_fft.GetSize());
+		for (size_t i = 0; i < m_window.size(); i += 1)
+		{
+			const double x = M_PI_TWO * static_cast<double>(i) / n;
+			switch (window)
+			{
+			case Window::Rectangular: m_window[i] = 1.0; break;
+			case Window::Hann: m_window[i] = 0.5 - 0.5 * cos(x); break;
+			case Window::Blackman: m_window[i] = 0.42 - 0.5 * cos(x) + 0.08 * cos(2.0 * x); break;
+			}
+		}
+	}
+
+	size_t GetFrameLength() const
+	{
+		return m_fft.GetSize();
+	}
+
+	size_t GetHop() const
+	{
+		return m_hop;
+	}
+
+	size_t GetBins() const
+	{
+		return m_fft.GetBins();
+	}
+
+	size_t GetFrames(size_t length) const
+	{
+		return (length + m_hop - 1) / m_hop;
+	}
+
+	size_t Power(const double* in, size_t length, std::vector<double>* out)
+	{
+		// Returns number of frames
+		const size_t frames = GetFrames(length);
+		const size_t bins = GetBins();
+		out->resize(frames * bins);
+
+		for (size_t f = 0; f < frames; f += 1)
+		{
+			Spectrum(in, length, f, m_re.data(), m_im.data());
+
+			double* o = out->data() + f * bins;
+			for (size_t i = 0; i < bins; i += 1)
+				o[i] = m_re[i] * m_re[i] + m_im[i] * m_im[i];
+		}
+
+		return frames;
+	}
+
+	void Spectrum(const double* in, size_t length, size_t frame, double* out_re, double* out_im)
+	{
+		// Of one frame, complex, outputs of 'GetBins()'
+		const size_t start = frame * m_hop;
+		const size_t available = (start < length) ? Min(length - start, m_frame.size()) : 0;
+
+		for (size_t i = 0; i < available; i += 1)
+			m_frame[i] = in[start + i] * m_window[i];
+		for (size_t i = available; i < m_frame.size(); i += 1)
+			m_frame[i] = 0.0;
+
+		m_fft.Forward(m_frame.data(), out_re, out_im);
+	}
+
+  private:
+	Fft m_fft;
+	size_t m_hop;
+
+	std::vector<double> m_window;
+	std::vector<double> m_frame;
+	std::vector<double> m_re;
+	std::vector<double> m_im;
+};
+
+
+struct Band
+{
+	double low;
+	double high;
+};
+
+inline std::vector<Band> OctaveBands(double lowest_center, double highest_center, int bands_per_octave = 1)
+{
+	// Centers from the lowest, 'bands_per_octave' of them per doubling,
+	// edges halfway (geometrically) between
+	const double step = pow(2.0, 1.0 / static_cast<double>(bands_per_octave));
+	const double half = sqrt(step);
+
+	std::vector<Band> bands;
+	for (double c = lowest_center; c <= highest_center * 1.001; c *= step)
+		bands.push_back({c / half, c * half});
+
+	return bands;
+}
+
+inline void BandEnergies(const double* power, size_t frames, size_t bins, double sampling_frequency,
+                         const std::vector<Band>& bands, std::vector<double>* out)
+{
+	// Per frame and band, in dB (floored at -200), frame after frame of
+	// 'bands.size()'. Bins by their center frequency
+	const double bin_width = sampling_frequency / static_cast<double>((bins - 1) * 2);
+	out->resize(frames * bands.size());
+
+	for (size_t b = 0; b < bands.size(); b += 1)
+	{
+		const auto first = static_cast<size_t>(ceil(bands[b].low / bin_width));
+		const auto last = Min(static_cast<size_t>(ceil(bands[b].high / bin_width)), bins);
+
+		for (size_t f = 0; f < frames; f += 1)
+		{
+			double sum = 0.0;
+			for (size_t i = first; i < last; i += 1)
+				sum += power[f * bins + i];
+
+			(*out)[f * bands.size() + b] = 10.0 * log10(Max(sum, 1e-20));
+		}
+	}
+}
+
+#endif
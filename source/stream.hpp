@@ -0,0 +1,166 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_STREAM_HPP
+#define MATSU_STREAM_HPP
+
+#include "matsu.hpp"
+
+enum class StreamFormat
+{
+	S16,
+	S24,
+	F32,
+	F64
+};
+
+inline bool StreamFormatFromName(const char* name, StreamFormat* out)
+{
+	// clang-format off
+	if (strcmp(name, "s16") == 0)      { *out = StreamFormat::S16; return true; }
+	else if (strcmp(name, "s24") == 0) { *out = StreamFormat::S24; return true; }
+	else if (strcmp(name, "f32") == 0) { *out = StreamFormat::F32; return true; }
+	else if (strcmp(name, "f64") == 0) { *out = StreamFormat::F64; return true; }
+	// clang-format on
+
+	return false;
+}
+
+
+class Stream
+{
+	// Raw, or WAV headered, pcm written as renders produce it. Pipes can't
+	// seek back to fix sizes, so header ones use the customary 0xFFFFFFFF
+	// 'unknown length' that most readers take as 'until end of stream'
+
+	static constexpr size_t BLOCK_LENGTH = 1024; // In samples
+
+  public:
+	Stream(FILE* fp, StreamFormat format, double sampling_frequency, bool wav_header)
+	{
+		m_fp = fp;
+		m_format = format;
+
+		if (wav_header == true)
+			WriteHeader(sampling_frequency);
+	}
+
+	Output GetOutput()
+	{
+		return Output(m_render_block, BLOCK_LENGTH, Stream::Flush, this);
+	}
+
+	bool Failed() const
+	{
+		return ferror(m_fp) != 0;
+	}
+
+  private:
+	FILE* m_fp;
+	StreamFormat m_format;
+
+	double m_render_block[BLOCK_LENGTH];
+	uint8_t m_block[BLOCK_LENGTH * sizeof(double)];
+
+	static void Flush(const double* samples, size_t length, void* user_data)
+	{
+		auto stream = static_cast<Stream*>(user_data);
+		uint8_t* out = stream->m_block;
+
+		const Kernels& kernels = GetKernels();
+
+		switch (stream->m_format)
+		{
+		case StreamFormat::S16:
+			kernels.to_s16(samples, length, out);
+			out += sizeof(int16_t) * length;
+			break;
+		case StreamFormat::S24:
+			kernels.to_s24(samples, length, out);
+			out += 3 * length;
+			break;
+		case StreamFormat::F32:
+			kernels.to_f32(samples, length, out);
+			out += sizeof(float) * length;
+			break;
+		case StreamFormat::F64:
+			memcpy(out, samples, sizeof(double) * length);
+			out += sizeof(double) * length;
+			break;
+		}
+
+		fwrite(stream->m_block, 1, static_cast<size_t>(out - stream->m_block), stream->m_fp);
+		fflush(stream->m_fp); // Readers on the other side start right away
+	}
+
+	void WriteHeader(double sampling_frequency)
+	{
+		const bool is_float = (m_format == StreamFormat::F32 || m_format == StreamFormat::F64);
+		uint32_t bits = 0;
+
+		// clang-format off
+		switch (m_format)
+		{
+		case StreamFormat::S16: bits = 16; break;
+		case StreamFormat::S24: bits = 24; break;
+		case StreamFormat::F32: bits = 32; break;
+		case StreamFormat::F64: bits = 64; break;
+		}
+		// clang-format on
+
+		const auto rate = static_cast<uint32_t>(sampling_frequency);
+		uint8_t* out = m_block;
+
+		out = PutTag("RIFF", out);
+		out = PutU32(0xFFFFFFFF, out);
+		out = PutTag("WAVE", out);
+
+		out = PutTag("fmt ", out);
+		out = PutU32(16, out);
+		out = PutU16((is_float == true) ? DR_WAVE_FORMAT_IEEE_FLOAT : DR_WAVE_FORMAT_PCM, out);
+		out = PutU16(1, out);                // Channels
+		out = PutU32(rate, out);             // Sampling frequency
+		out = PutU32(rate * bits / 8, out);  // Bytes per second
+		out = PutU16(bits / 8, out);         // Block align
+		out = PutU16(bits, out);             // Bits per sample
+
+		out = PutTag("data", out);
+		out = PutU32(0xFFFFFFFF, out);
+
+		fwrite(m_block, 1, static_cast<size_t>(out - m_block), m_fp);
+	}
+
+	static uint8_t* PutTag(const char* tag, uint8_t* out)
+	{
+		memcpy(out, tag, 4);
+		return out + 4;
+	}
+
+	static uint8_t* PutU16(uint32_t v, uint8_t* out)
+	{
+		*out++ = static_cast<uint8_t>((v >> 0) & 0xFF);
+		*out++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+		return out;
+	}
+
+	static uint8_t* PutU32(uint32_t v, uint8_t* out)
+	{
+		*out++ = static_cast<uint8_t>((v >> 0) & 0xFF);
+		*out++ = static_cast<uint8_t>((v >> 8) & 0xFF);
+		*out++ = static_cast<uint8_t>((v >> 16) & 0xFF);
+		*out++ = static_cast<uint8_t>((v >> 24) & 0xFF);
+		return out;
+	}
+};
+
+#endif
@@ -0,0 +1,217 @@
+/*
+
+Copyright (c) 2024 Alexander Brandt
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+This Source Code Form is "Incompatible With Secondary Licenses", as
+defined by the Mozilla Public License, v. 2.0.
+*/
+
+
+#ifndef MATSU_TRACE_HPP
+#define MATSU_TRACE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+
+// Timeline of what every thread did, as Chrome trace Json (chrome://tracing,
+// https://ui.perfetto.dev). Off until 'TraceStart()', scopes then cost a
+// relaxed load and a branch. Once on, each thread records into a buffer of
+// its own, allocated on its first event and kept to the end of the program,
+// so recording takes no locks. Names and categories must outlive that too
+// (string literals). Buffers are written out after threads are done with
+// them, once joined
+
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+
+
+struct TraceEvent
+{
+	const char* name;
+	const char* category;
+	uint64_t begin; // Nanoseconds from 'TraceStart()'
+	uint64_t end;   // Same as begin for instants
+};
+
+struct TraceBuffer
+{
+	static constexpr size_t CAPACITY = 1 << 16; // Events past it dropped, and counted
+
+	TraceEvent events[CAPACITY];
+	std::atomic<size_t> length;
+	size_t dropped;
+	uint32_t thread;
+	TraceBuffer* next; // All of them, newest first
+};
+
+struct TraceState
+{
+	std::atomic<bool> enabled;
+	std::atomic<uint32_t> threads;
+	std::atomic<TraceBuffer*> buffers;
+	std::chrono::steady_clock::time_point start;
+};
+
+inline TraceState& GetTraceState()
+{
+	static TraceState state;
+	return state;
+}
+
+
+inline void TraceStart()
+{
+	TraceState& s = GetTraceState();
+	s.start = std::chrono::steady_clock::now();
+	s.enabled.store(true, std::memory_order_release);
+}
+
+inline bool TraceEnabled()
+{
+	return GetTraceState().enabled.load(std::memory_order_relaxed);
+}
+
+inline uint64_t TraceNow()
+{
+	const auto elapsed = std::chrono::steady_clock::now() - GetTraceState().start;
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+inline TraceBuffer* TraceThreadBuffer()
+{
+	// Pushed onto the list with a compare and swap, the only thing shared
+	static thread_local TraceBuffer* buffer = nullptr;
+	if (buffer != nullptr)
+		return buffer;
+
+	TraceState& s = GetTraceState();
+	buffer = new TraceBuffer;
+	buffer->length.store(0, std::memory_order_relaxed);
+	buffer->dropped = 0;
+	buffer->thread = s.threads.fetch_add(1, std::memory_order_relaxed);
+	buffer->next = s.buffers.load(std::memory_order_relaxed);
+
+	while (s.buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release,
+	                                       std::memory_order_relaxed) == false)
+	{
+	}
+
+	return buffer;
+}
+
+inline void TraceRecord(const char* name, const char* category, uint64_t begin, uint64_t end)
+{
+	TraceBuffer* b = TraceThreadBuffer();
+	const size_t length = b->length.load(std::memory_order_relaxed);
+	if (length == TraceBuffer::CAPACITY)
+	{
+		b->dropped += 1;
+		return;
+	}
+
+	b->events[length] = {name, category, begin, end};
+	b->length.store(length + 1, std::memory_order_release);
+}
+
+inline void TraceInstant(const char* name, const char* category)
+{
+	// A mark at a point in time, rather than a span
+	if (TraceEnabled() == false)
+		return;
+
+	const uint64_t now = TraceNow();
+	TraceRecord(name, category, now, now);
+}
+
+
+class TraceScope
+{
+  public:
+	TraceScope(const char* name, const char* category)
+	{
+		m_name = name;
+		m_category = category;
+		m_begin = (TraceEnabled() == true) ? TraceNow() : UINT64_MAX;
+	}
+
+	~TraceScope()
+	{
+		// Scopes begun before 'TraceStart()' not recorded. Never of zero
+		// length, that being how instants are told apart
+		if (m_begin != UINT64_MAX)
+		{
+			const uint64_t end = TraceNow();
+			TraceRecord(m_name, m_category, m_begin, (end > m_begin) ? end : m_begin + 1);
+		}
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+	const char* m_name;
+	const char* m_category;
+	uint64_t m_begin;
+};
+
+#define MATSU_TRACE_CONCAT2(a, b) a##b
+#define MATSU_TRACE_CONCAT(a, b) MATSU_TRACE_CONCAT2(a, b)
+#define MATSU_TRACE_SCOPE(name, category) TraceScope MATSU_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
+
+
+inline bool TraceWrite(const char* filename)
+{
+	// Complete events ('X') for scopes, instants ('i') for the rest, every
+	// thread named after its order of arrival. Microseconds
+	FILE* fp = fopen(filename, "w");
+	if (fp == nullptr)
+		return false;
+
+	fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	bool first = true;
+	size_t dropped = 0;
+
+	for (const TraceBuffer* b = GetTraceState().buffers.load(std::memory_order_acquire); b != nullptr; b = b->next)
+	{
+		fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+		        "\"args\": {\"name\": \"Thread %u\"}}", (first == true) ? "" : ",\n", b->thread, b->thread);
+		first = false;
+
+		const size_t length = b->length.load(std::memory_order_acquire);
+		for (size_t i = 0; i < length; i += 1)
+		{
+			const TraceEvent& e = b->events[i];
+			if (e.end == e.begin)
+			{
+				fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %.3f, "
+				        "\"pid\": 1, \"tid\": %u}", e.name, e.category, static_cast<double>(e.begin) / 1000.0,
+				        b->thread);
+			}
+			else
+			{
+				fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+				        "\"pid\": 1, \"tid\": %u}", e.name, e.category, static_cast<double>(e.begin) / 1000.0,
+				        static_cast<double>(e.end - e.begin) / 1000.0, b->thread);
+			}
+		}
+
+		dropped += b->dropped;
+	}
+
+	fprintf(fp, "\n]}\n");
+	const bool failure = (ferror(fp) != 0);
+	fclose(fp);
+
+	if (dropped != 0)
+		fprintf(stderr, "Trace buffers full, %zu events dropped\n", dropped);
+
+	return (failure == false);
+}
+
+#endif